@@ -0,0 +1,114 @@
+#define _GNU_SOURCE
+
+#include <pthread.h>
+
+#include "modes.h"
+
+// Adaptive mode: the transactions of a window of ADAPT_WINDOW are counted, and
+// at the end of the window the mode is chosen again from their abort rate and
+// from the most transactions that ran at once:
+//  - at most one at a time: the lock, which never aborts and costs no logging
+//  - several, under the lock: the optimistic mode, which lets them overlap
+//  - many aborts, optimistic: the batcher, whose epochs bound the conflicts
+//  - many aborts, batcher: the lock
+//  - few aborts, batcher: the optimistic mode, which skips the epoch barrier
+// A switch waits for the running transactions to leave, so that no
+// transaction of the previous mode runs in the next one: its epoch is over.
+
+void mode_init(struct Region *reg) {
+  pthread_rwlockattr_t attr;
+
+  // A switch must not wait behind a stream of new transactions
+  pthread_rwlockattr_init(&attr);
+  pthread_rwlockattr_setkind_np(&attr,
+                                PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+  pthread_rwlock_init(&reg->gate, &attr);
+  pthread_rwlockattr_destroy(&attr);
+
+  atomic_init(&reg->ended, 0);
+  atomic_init(&reg->aborted, 0);
+  atomic_init(&reg->in_flight, 0);
+  atomic_init(&reg->max_in_flight, 0);
+  atomic_init(&reg->switching, false);
+}
+
+void mode_destroy(struct Region *reg) { pthread_rwlock_destroy(&reg->gate); }
+
+enum Mode mode_enter(struct Region *reg) {
+  if (!reg->options.adaptive) {
+    return reg->mode;
+  }
+
+  pthread_rwlock_rdlock(&reg->gate);
+
+  size_t in_flight = atomic_fetch_add(&reg->in_flight, 1) + 1;
+  size_t max = atomic_load_explicit(&reg->max_in_flight, memory_order_relaxed);
+
+  while (in_flight > max &&
+         !atomic_compare_exchange_weak(&reg->max_in_flight, &max, in_flight)) {
+  }
+
+  return reg->mode;
+}
+
+// Mode for the next window
+static enum Mode mode_next(struct Region *reg) {
+  size_t ended = atomic_load(&reg->ended);
+  size_t aborts = ended == 0 ? 0 : atomic_load(&reg->aborted) * 1000 / ended;
+
+  if (atomic_load(&reg->max_in_flight) <= 1) {
+    return MODE_LOCK;
+  }
+
+  switch (reg->mode) {
+  case MODE_LOCK:
+    return MODE_OPTIMISTIC;
+  case MODE_OPTIMISTIC:
+    return aborts > ADAPT_ABORTS_HIGH ? MODE_BATCHER : MODE_OPTIMISTIC;
+  case MODE_BATCHER:
+    if (aborts > ADAPT_ABORTS_HIGH) {
+      return MODE_LOCK;
+    }
+    return aborts < ADAPT_ABORTS_LOW ? MODE_OPTIMISTIC : MODE_BATCHER;
+  }
+
+  return reg->mode;
+}
+
+static void mode_switch(struct Region *reg) {
+  pthread_rwlock_wrlock(&reg->gate);
+
+  // Unless another thread already switched for this window
+  if (atomic_load(&reg->ended) >= ADAPT_WINDOW) {
+    reg->mode = mode_next(reg);
+
+    atomic_store(&reg->ended, 0);
+    atomic_store(&reg->aborted, 0);
+    atomic_store(&reg->max_in_flight, 0);
+  }
+
+  pthread_rwlock_unlock(&reg->gate);
+  atomic_store(&reg->switching, false);
+}
+
+void mode_leave(struct Region *reg, bool committed) {
+  if (!reg->options.adaptive) {
+    return;
+  }
+
+  size_t ended = atomic_fetch_add(&reg->ended, 1) + 1;
+
+  if (!committed) {
+    atomic_fetch_add(&reg->aborted, 1);
+  }
+
+  atomic_fetch_sub(&reg->in_flight, 1);
+  pthread_rwlock_unlock(&reg->gate);
+
+  bool idle = false;
+
+  if (ended >= ADAPT_WINDOW &&
+      atomic_compare_exchange_strong(&reg->switching, &idle, true)) {
+    mode_switch(reg);
+  }
+}
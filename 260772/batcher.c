@@ -1,4 +1,5 @@
 #include "batcher.h"
+#include "probes.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -7,27 +8,17 @@
 void init_batcher(struct Batcher *batcher)
 {
   pthread_mutex_init(&batcher->lock_cond, NULL);
-  pthread_mutex_init(&batcher->lock, NULL);
-  pthread_mutex_init(&batcher->read_lock, NULL);
-  pthread_mutex_init(&batcher->write_lock, NULL);
-  pthread_mutex_init(&batcher->alloc_lock, NULL);
-  pthread_mutex_init(&batcher->free_lock, NULL);
   pthread_cond_init(&batcher->empty, NULL);
   batcher->keep_waiting = true;
   batcher->epoch = 1;    // epoch starts at 1, because of written
-  batcher->tx_count = 1; // Id starts at 1
   batcher->remaining = 0;
   batcher->n_blocked = 0;
+  batcher->exclusive = false;
 }
 
 void batcher_destroy(struct Batcher *batcher)
 {
   pthread_mutex_destroy(&batcher->lock_cond);
-  pthread_mutex_destroy(&batcher->lock);
-  pthread_mutex_destroy(&batcher->alloc_lock);
-  pthread_mutex_destroy(&batcher->free_lock);
-  pthread_mutex_destroy(&batcher->read_lock);
-  pthread_mutex_destroy(&batcher->write_lock);
   pthread_cond_destroy(&batcher->empty);
 }
 
@@ -81,22 +72,69 @@ void batcher_destroy(struct Batcher *batcher)
 //   pthread_mutex_unlock(&batcher->lock_cond);
 // }
 
-void enter(struct Batcher *batcher)
+// Join the current epoch, or the next one if the current one is running.
+// Returns whether the caller is alone in its epoch: no transaction is in it and
+// none was woken to join it, so any other one waits for the next epoch.
+bool enter(struct Batcher *batcher)
 {
   pthread_mutex_lock(&batcher->lock_cond);
 
-  if (batcher->remaining > 0)
+  if (batcher->remaining > 0 || batcher->exclusive)
   {
     batcher->keep_waiting = true;
+    ++batcher->n_blocked;
+    probe3(wait_start, batcher, (size_t)batcher->epoch, false);
 
-    while (batcher->keep_waiting)
+    while (batcher->keep_waiting || batcher->exclusive)
     {
       pthread_cond_wait(&batcher->empty, &batcher->lock_cond);
     }
+
+    --batcher->n_blocked;
+    probe3(wait_end, batcher, (size_t)batcher->epoch, false);
   }
+
+  bool alone = batcher->remaining == 0 && batcher->n_blocked == 0;
+
   // printf("%d\n", batcher->remaining);
   atomic_fetch_add(&batcher->remaining, 1);
   pthread_mutex_unlock(&batcher->lock_cond);
+
+  return alone;
+}
+
+// Wait for an epoch of its own: once the current epoch is over, no other
+// transaction joins until leave_exclusive. One such epoch at a time.
+void enter_exclusive(struct Batcher *batcher)
+{
+  pthread_mutex_lock(&batcher->lock_cond);
+  probe3(wait_start, batcher, (size_t)batcher->epoch, true);
+
+  while (batcher->exclusive)
+  {
+    pthread_cond_wait(&batcher->empty, &batcher->lock_cond);
+  }
+
+  batcher->exclusive = true;
+
+  while (batcher->remaining > 0)
+  {
+    pthread_cond_wait(&batcher->empty, &batcher->lock_cond);
+  }
+
+  probe3(wait_end, batcher, (size_t)batcher->epoch, true);
+  atomic_fetch_add(&batcher->remaining, 1);
+  pthread_mutex_unlock(&batcher->lock_cond);
+}
+
+void leave_exclusive(struct Batcher *batcher, void (*commit)(void *),
+                     void *shared)
+{
+  pthread_mutex_lock(&batcher->lock_cond);
+  batcher->exclusive = false;
+  pthread_mutex_unlock(&batcher->lock_cond);
+
+  leave(batcher, commit, shared);
 }
 
 void leave(struct Batcher *batcher, void (*commit)(void *), void *shared)
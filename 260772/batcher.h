@@ -6,26 +6,33 @@
 #include <unistd.h>
 #include <assert.h>
 
+#include "config.h"
+
 #define N_THREAD 256
 
+// Start a new cache line, so that fields written by different threads (or
+// written vs. read-mostly) do not share one
+#define cache_aligned _Alignas(CACHE_LINE_SIZE)
+
 struct Batcher
 {
+  // Epoch state, only changed under lock_cond by enter/leave
+  cache_aligned pthread_mutex_t lock_cond;
   pthread_cond_t empty; // broadcast signal when remaining is 0 (i.e. empty)
-  pthread_mutex_t lock_cond;
-  pthread_mutex_t lock;
-  pthread_mutex_t read_lock;
-  pthread_mutex_t write_lock;
-  pthread_mutex_t alloc_lock;
-  pthread_mutex_t free_lock;
   atomic_bool keep_waiting;
   atomic_size_t epoch;
-  atomic_uint tx_count;
   atomic_uint remaining;
-  atomic_uint n_blocked;
+  atomic_uint n_blocked; // Waiting for the next epoch, or woken and not yet
+                         // counted in remaining
+  bool exclusive; // An irrevocable transaction has or waits for an epoch of
+                  // its own, the other ones wait until it leaves
 };
 
 void init_batcher(struct Batcher *batcher);
 void batcher_destroy(struct Batcher *batcher);
 size_t get_epoch(struct Batcher *batcher);
-void enter(struct Batcher *batcher);
+bool enter(struct Batcher *batcher);
+void enter_exclusive(struct Batcher *batcher);
+void leave_exclusive(struct Batcher *batcher, void (*commit)(void *),
+                     void *shared);
 void leave(struct Batcher *batcher, void (*commit)(void *), void *shared);
\ No newline at end of file
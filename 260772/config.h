@@ -0,0 +1,131 @@
+#pragma once
+
+// Compile-time options of the transaction manager. Each option can be
+// overridden from the command line, e.g. make CC="cc -DUSE_VMEM=0".
+
+// Lay the whole region out in one contiguous virtual reservation (write copies,
+// read copies and controls at fixed offsets from each other), so translating a
+// shared address is pure arithmetic. When 0, segments are separate allocations
+// found through the per-segment tables and addresses encode the segment index;
+// TM_MODE=optimistic and adaptive then fall back to batcher.
+#ifndef USE_VMEM
+#define USE_VMEM 1
+#endif
+
+// log2 of the size of one segment slot in the reservation. A segment uses as
+// many consecutive slots as it needs, there are MAX_SEGMENTS slots per copy.
+// Halved at creation until the reservation succeeds.
+#ifndef VMEM_SLOT_SHIFT
+#define VMEM_SLOT_SHIFT 24
+#endif
+
+// log2 of the size of a huge page, used when huge pages are requested
+// (TM_HUGEPAGES, see options.h)
+#ifndef HUGE_PAGE_SHIFT
+#define HUGE_PAGE_SHIFT 21
+#endif
+
+// Size of a cache line. Fields written by different threads, or written
+// fields and read-mostly ones, are kept on separate lines (see cache_aligned).
+#ifndef CACHE_LINE_SIZE
+#define CACHE_LINE_SIZE 64
+#endif
+
+// Number of transaction ids a thread takes at once from the global id counter,
+// a power of 2. Larger blocks make that counter line colder.
+#ifndef TX_ID_BLOCK
+#define TX_ID_BLOCK 1024
+#endif
+
+// Run a read-write transaction that is alone in its epoch in place: its
+// writes go straight to the read copies, with an undo list instead of the
+// per-word controls, as no other transaction can observe them
+#ifndef USE_SOLO
+#define USE_SOLO 1
+#endif
+
+// Adaptive mode (TM_MODE=adaptive): number of transactions between two mode
+// decisions, and abort rates (per thousand transactions) under which the
+// optimistic mode is preferred and over which it is given up
+#ifndef ADAPT_WINDOW
+#define ADAPT_WINDOW 4096
+#endif
+#ifndef ADAPT_ABORTS_LOW
+#define ADAPT_ABORTS_LOW 20
+#endif
+#ifndef ADAPT_ABORTS_HIGH
+#define ADAPT_ABORTS_HIGH 200
+#endif
+
+// Contention manager (TM_CM): the backoff window after the first abort (in
+// nanoseconds), log2 of its largest growth, the work (accesses) worth halving
+// it for "karma", and the consecutive aborts after which "serialize" runs a
+// transaction alone
+#ifndef CM_BACKOFF_NS
+#define CM_BACKOFF_NS 512
+#endif
+#ifndef CM_BACKOFF_MAX_SHIFT
+#define CM_BACKOFF_MAX_SHIFT 10
+#endif
+#ifndef CM_KARMA_UNIT
+#define CM_KARMA_UNIT 64
+#endif
+#ifndef CM_SERIALIZE_AFTER
+#define CM_SERIALIZE_AFTER 8
+#endif
+
+// Consecutive aborts after which a transaction is retried irrevocably, by
+// default (TM_IRREVOCABLE_AFTER), 0 for never
+#ifndef IRREVOCABLE_AFTER
+#define IRREVOCABLE_AFTER 16
+#endif
+
+// Keep the counters of tm_stats, per thread, for the regions created with
+// TM_STATS set. Without them, counting compiles to nothing.
+#ifndef USE_STATS
+#define USE_STATS 1
+#endif
+
+// A thread times one of its commits in STATS_SAMPLE, for tm_stats
+#ifndef STATS_SAMPLE
+#define STATS_SAMPLE 8
+#endif
+
+// Words that made it abort the most each thread keeps track of, for tm_stats,
+// 0 for none
+#ifndef ABORT_SITES
+#define ABORT_SITES 64
+#endif
+
+// Record the timeline of the transactions of a region traced with TM_TRACE
+// (trace.h). Without it, recording compiles to nothing.
+#ifndef USE_TRACE
+#define USE_TRACE 1
+#endif
+
+// Last events each thread keeps for the trace, a power of 2
+#ifndef TRACE_EVENTS
+#define TRACE_EVENTS 65536
+#endif
+
+// Static probes (probes.h) for perf and bpftrace, when <sys/sdt.h> is there
+#ifndef USE_PROBES
+#define USE_PROBES 1
+#endif
+
+// Contention profiler (TM_PROFILE, profile.h): count-min sketch of
+// PROFILE_DEPTH rows of PROFILE_WIDTH counters (a power of 2), and the
+// PROFILE_TOP most contended words kept. Without USE_PROFILE, profiling
+// compiles to nothing.
+#ifndef USE_PROFILE
+#define USE_PROFILE 1
+#endif
+#ifndef PROFILE_DEPTH
+#define PROFILE_DEPTH 4
+#endif
+#ifndef PROFILE_WIDTH
+#define PROFILE_WIDTH 4096
+#endif
+#ifndef PROFILE_TOP
+#define PROFILE_TOP 32
+#endif
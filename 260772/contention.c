@@ -0,0 +1,92 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+
+#include "contention.h"
+#include "macros.h"
+
+initial_exec _Thread_local uint64_t cm_work = 0;
+
+// Transaction being retried by the calling thread
+static _Thread_local unsigned int cm_aborts = 0; // Consecutive aborts
+static _Thread_local uint64_t cm_karma = 0;      // Work lost by them
+static _Thread_local bool cm_serialized = false; // Holds reg->serial
+
+static _Thread_local uint64_t cm_seed = 0;
+
+// xorshift64, seeded per thread
+static uint64_t cm_random(void) {
+  if (unlikely(cm_seed == 0)) {
+    cm_seed = (uintptr_t)&cm_seed | 1;
+  }
+
+  cm_seed ^= cm_seed << 13;
+  cm_seed ^= cm_seed >> 7;
+  cm_seed ^= cm_seed << 17;
+
+  return cm_seed;
+}
+
+void cm_init(struct Region *reg) {
+  pthread_mutex_init(&reg->serial, NULL);
+}
+
+void cm_destroy(struct Region *reg) { pthread_mutex_destroy(&reg->serial); }
+
+void cm_begin(struct Region *reg) {
+  cm_work = 0;
+
+  if (reg->options.contention == CM_SERIALIZE &&
+      cm_aborts >= CM_SERIALIZE_AFTER) {
+    pthread_mutex_lock(&reg->serial);
+    cm_serialized = true;
+  }
+}
+
+void cm_end(struct Region *reg, bool committed) {
+  if (cm_serialized) {
+    pthread_mutex_unlock(&reg->serial);
+    cm_serialized = false;
+  }
+
+  if (committed) {
+    cm_aborts = 0;
+    cm_karma = 0;
+  } else {
+    ++cm_aborts;
+    cm_karma += cm_work;
+  }
+}
+
+// Random time in a window doubling with each consecutive abort, so that the
+// transactions that aborted each other retry apart
+uint64_t cm_wait(struct Region *reg) {
+  enum ContentionPolicy policy = reg->options.contention;
+
+  if (cm_aborts == 0 || policy == CM_NONE || cm_promote(reg)) {
+    return 0;
+  }
+
+  // The next attempt waits for its turn instead
+  if (policy == CM_SERIALIZE && cm_aborts >= CM_SERIALIZE_AFTER) {
+    return 0;
+  }
+
+  unsigned int shift =
+      cm_aborts - 1 < CM_BACKOFF_MAX_SHIFT ? cm_aborts - 1 : CM_BACKOFF_MAX_SHIFT;
+  uint64_t window = (uint64_t)CM_BACKOFF_NS << shift;
+
+  // The more work lost, the sooner the retry
+  if (policy == CM_KARMA) {
+    window /= 1 + cm_karma / CM_KARMA_UNIT;
+  }
+
+  return window == 0 ? 0 : cm_random() % window;
+}
+
+// Whether the next attempt of the calling thread must not abort again
+bool cm_promote(struct Region *reg) {
+  unsigned int after = reg->options.irrevocable_after;
+
+  return after > 0 && cm_aborts >= after;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "helper.h"
+#include "macros.h"
+
+// Contention manager. Each thread counts the consecutive aborts of the
+// transaction it retries, and the work (accesses) those attempts lost. From
+// them the policy of the region (options.contention, TM_CM) decides how long
+// the thread waits before the next attempt (cm_wait, i.e. tm_should_wait),
+// and whether that attempt runs serialized with the other starving ones, or
+// irrevocably (cm_promote) once it aborted options.irrevocable_after times.
+
+// Accesses done by the current attempt of the calling thread
+extern initial_exec _Thread_local uint64_t cm_work;
+
+static inline void cm_access(void) { ++cm_work; }
+
+void cm_init(struct Region *reg);
+void cm_destroy(struct Region *reg);
+void cm_begin(struct Region *reg);
+void cm_end(struct Region *reg, bool committed);
+uint64_t cm_wait(struct Region *reg);
+bool cm_promote(struct Region *reg);
@@ -1,13 +1,48 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "helper.h"
 #include "macros.h"
+#include "probes.h"
+#include "profile.h"
+#include "segment.h"
+#include "stats.h"
+#include "trace.h"
 
 #define _GNU_SOURCE
 #define _POSIX_C_SOURCE 200809L
 
+_Static_assert((TX_ID_BLOCK & (TX_ID_BLOCK - 1)) == 0,
+               "TX_ID_BLOCK must be a power of 2");
+
+// Next block of transaction ids to hand out, the only shared state of tx_id
+static cache_aligned atomic_size_t tx_id_blocks = 0;
+
+// Ids left in the block of the calling thread, in [tx_id_next, tx_id_end)
+static _Thread_local size_t tx_id_next = 0;
+static _Thread_local size_t tx_id_end = 0;
+
+// New transaction id, never 0 (tx_read is reset to 0) and unique among the
+// transactions of an epoch. Each thread takes ids from its own block, so the
+// global counter is only touched once every TX_ID_BLOCK transactions.
+size_t tx_id(void) {
+  if (unlikely(tx_id_next == tx_id_end)) {
+    // Blocks never straddle the wraparound, as TX_ID_BLOCK divides the range
+    tx_id_next =
+        (atomic_fetch_add(&tx_id_blocks, 1) * TX_ID_BLOCK) & TX_ID_MASK;
+    tx_id_end = tx_id_next + TX_ID_BLOCK;
+
+    if (tx_id_next == 0) {
+      ++tx_id_next;
+    }
+  }
+
+  return tx_id_next++;
+}
+
 void printBits(unsigned int num)
 {
    for(int bit=0;bit<(sizeof(unsigned int) * 8); bit++)
@@ -17,21 +52,40 @@ void printBits(unsigned int num)
    }
 }
 
-bool read_word(struct Region *reg, tx_t tx, void *target, size_t segment_index,
-               size_t word_index, acs access_type_id) {
-  struct Control *control = &reg->controls[segment_index][word_index];
+// Count an abort on the word, from the access that failed and the control that
+// made it fail
+static void conflict(struct Region *reg, void const *address, bool write) {
+  acs value = atomic_load(&word_control(reg, address)->access_type_id);
+  enum tm_abort_reason reason;
+
+  if (value == ACS_ADD_INIT || ACS_IS_ADD(value)) {
+    reason = tm_abort_add;
+  } else if (!write) {
+    reason = tm_abort_read_written;
+  } else if (value == ACS_FIRST_READ || value == ACS_MORE_READ) {
+    reason = tm_abort_write_read;
+  } else {
+    reason = tm_abort_write_written;
+  }
+
+  stats_abort(reg, reason, address);
+  profile(reg, address, PROFILE_CONFLICT);
+}
+
+bool read_word(struct Region *reg, tx_t tx, void *target, void const *source,
+               acs access_type_id) {
   struct Transaction *tr = (struct Transaction *)tx;
 
   if (tx == read_only_tx) {
-    void *word =
-        (char *)reg->segments_read[segment_index] + word_index * reg->align;
-    memcpy(target, word, reg->align);
+    memcpy(target, word_read_copy(reg, source), reg->align);
 
     return true;
   }
 
+  struct Control *control = word_control(reg, source);
+
   if (atomic_load(&control->access_type_id) == access_type_id) {
-    memcpy(target, control->write_word, reg->align);
+    memcpy(target, word_write_copy(reg, source), reg->align);
 
     return true;
   }
@@ -44,21 +98,23 @@ bool read_word(struct Region *reg, tx_t tx, void *target, size_t segment_index,
 
     control->tx_read = tr->id;
 
-    control->write_word =
-        (char *)reg->segments_write[segment_index] + word_index * reg->align;
-    control->read_word =
-        (char *)reg->segments_read[segment_index] + word_index * reg->align;
+#if !USE_VMEM
+    control->write_word = word_write_copy(reg, source);
+    control->read_word = word_read_copy(reg, source);
     control->saved = 1;
+#endif
 
     insert_list(&tr->accessed_words, control, struct Control *);
 
-    memcpy(target, control->read_word, reg->align);
+    memcpy(target, word_read_copy(reg, source), reg->align);
 
     return true;
   }
 
+  profile(reg, source, PROFILE_CAS);
+
   if (atomic_load(&control->tx_read) == tr->id) {
-    memcpy(target, control->read_word, reg->align);
+    memcpy(target, word_read_copy(reg, source), reg->align);
 
     return true;
   }
@@ -66,24 +122,26 @@ bool read_word(struct Region *reg, tx_t tx, void *target, size_t segment_index,
   if (atomic_compare_exchange_strong(&control->access_type_id, &expected_acs_2,
                                      ACS_MORE_READ) ||
       atomic_load(&control->access_type_id) == ACS_MORE_READ) {
-    // control->accessed_epoch = reg->batcher.epoch;
+    // control->accessed_epoch = (size_t)reg->batcher.epoch;
     // control->access_set = tr->id;
 
-    memcpy(target, control->read_word, reg->align);
+    memcpy(target, word_read_copy(reg, source), reg->align);
 
     return true;
   }
 
+  conflict(reg, source, false);
+
   return false;
 }
 
-bool write_word(struct Region *reg, tx_t tx, void const *source,
-                size_t segment_index, size_t word_index, acs access_type_id) {
-  struct Control *control = &reg->controls[segment_index][word_index];
+bool write_word(struct Region *reg, tx_t tx, void const *source, void *target,
+                acs access_type_id) {
+  struct Control *control = word_control(reg, target);
   struct Transaction *tr = (struct Transaction *)tx;
 
   if (atomic_load(&control->access_type_id) == access_type_id) {
-    memcpy(control->write_word, source, reg->align);
+    memcpy(word_write_copy(reg, target), source, reg->align);
 
     return true;
   }
@@ -95,75 +153,219 @@ bool write_word(struct Region *reg, tx_t tx, void const *source,
                                      access_type_id) ||
       atomic_compare_exchange_strong(&control->access_type_id, &expected_acs_2,
                                      access_type_id)) {
+#if !USE_VMEM
     if (!control->saved) {
-      control->write_word =
-          (char *)reg->segments_write[segment_index] + word_index * reg->align;
-      control->read_word =
-          (char *)reg->segments_read[segment_index] + word_index * reg->align;
+      control->write_word = word_write_copy(reg, target);
+      control->read_word = word_read_copy(reg, target);
       control->saved = 1;
     }
+#endif
 
     if (!control->accessed_write) {
       insert_list(&tr->accessed_words, control, struct Control *);
       control->accessed_write = 1;
     }
 
-    memcpy(control->write_word, source, reg->align);
+    memcpy(word_write_copy(reg, target), source, reg->align);
 
     return true;
   }
 
+  profile(reg, target, PROFILE_CAS);
+  conflict(reg, target, true);
+
   return false;
 }
 
-uintptr_t next_free(struct Region *reg) {
-  // Take the next available index O(1) time if the number of allocations is
-  // less than the maximum. Index go from 0 to MAX_SEGMENTS - 1
-  if (reg->n_segments < MAX_SEGMENTS) {
-    return atomic_fetch_add(&reg->n_segments, 1);
+static uint64_t load_int(void const *source, size_t width) {
+  switch (width) {
+  case 1:
+    return *(uint8_t const *)source;
+  case 2:
+    return *(uint16_t const *)source;
+  case 4:
+    return *(uint32_t const *)source;
+  default:
+    return *(uint64_t const *)source;
   }
+}
 
-  // Search the first index with non allocated segment. O(n) time.
-  unsigned int i = 0;
-  while (reg->segments_write[i] != NULL) {
-    ++i;
+// Two's complement, i.e. unsigned, wrapping additions
+void add_int(void *target, int64_t delta, size_t width) {
+  uint64_t value = load_int(target, width) + (uint64_t)delta;
+
+  switch (width) {
+  case 1:
+    *(uint8_t *)target = (uint8_t)value;
+    break;
+  case 2:
+    *(uint16_t *)target = (uint16_t)value;
+    break;
+  case 4:
+    *(uint32_t *)target = (uint32_t)value;
+    break;
+  default:
+    *(uint64_t *)target = value;
   }
+}
 
-  return i;
+void add_int_atomic(void *target, int64_t delta, size_t width) {
+  switch (width) {
+  case 1:
+    __atomic_fetch_add((uint8_t *)target, (uint8_t)delta, __ATOMIC_RELAXED);
+    break;
+  case 2:
+    __atomic_fetch_add((uint16_t *)target, (uint16_t)delta, __ATOMIC_RELAXED);
+    break;
+  case 4:
+    __atomic_fetch_add((uint32_t *)target, (uint32_t)delta, __ATOMIC_RELAXED);
+    break;
+  default:
+    __atomic_fetch_add((uint64_t *)target, (uint64_t)delta, __ATOMIC_RELAXED);
+  }
 }
 
-void seg_free(shared_t shared, uintptr_t index) {
-  struct Region *reg = (struct Region *)shared;
+// Join the adders of the word, unless it is written by another transaction.
+// The delta is only added to the sum if the transaction commits.
+bool add_word(struct Region *reg, struct Transaction *tr, void *target,
+              int64_t delta, size_t width, acs access_type_id) {
+  struct Control *control = word_control(reg, target);
+  acs added = ACS_ADD(width);
+  acs value = atomic_load(&control->access_type_id);
+
+  // Written by this transaction: an addition like any other write
+  if (value == access_type_id) {
+    add_int(word_write_copy(reg, target), delta, width);
+    return true;
+  }
+
+  // Readers come before the adders, as they come before a writer
+  while (value != added) {
+    if (value == ACS_ADD_INIT) {
+      value = atomic_load(&control->access_type_id);
+      continue;
+    }
+
+    if (value != ACS_NULL && value != ACS_FIRST_READ &&
+        value != ACS_MORE_READ) {
+      stats_abort(reg, tm_abort_add, target);
+      profile(reg, target, PROFILE_CONFLICT);
+      return false;
+    }
 
-  // assert(reg->segments_write[index] != NULL);
-  // assert(reg->segments_read[index] != NULL);
-  // assert(reg->controls[index] != NULL);
+    if (atomic_compare_exchange_strong(&control->access_type_id, &value,
+                                       ACS_ADD_INIT)) {
+#if !USE_VMEM
+      if (!control->saved) {
+        control->write_word = word_write_copy(reg, target);
+        control->read_word = word_read_copy(reg, target);
+        control->saved = 1;
+      }
+#endif
+      memset(word_write_copy(reg, target), 0, reg->align);
+
+      // Committed at the end of the epoch whether or not this transaction
+      // commits, as other ones may add to it
+      pthread_mutex_lock(&reg->modified_controls_lock);
+      insert_list(&reg->modified_controls, control, struct Control *);
+      pthread_mutex_unlock(&reg->modified_controls_lock);
+
+      atomic_store(&control->access_type_id, added);
+      break;
+    }
+
+    profile(reg, target, PROFILE_CAS);
+  }
+
+  struct Add add = {
+      .sum = word_write_copy(reg, target), .delta = delta, .width = width};
 
-  free(reg->segments_write[index]);
-  free(reg->segments_read[index]);
-  free(reg->controls[index]);
+  insert_list(&tr->adds, add, struct Add);
 
-  // To indicate a free index
-  reg->segments_write[index] = NULL;
-  reg->segments_read[index] = NULL;
-  reg->controls[index] = NULL;
+  return true;
+}
+
+// A solo transaction sees no other write: the committed state is its own,
+// and the read copy of a range of a segment is contiguous
+void read_solo(struct Region *reg, void *target, void const *source,
+               size_t size) {
+  memcpy(target, word_read_copy(reg, source), size);
+}
+
+bool write_solo(struct Region *reg, struct Transaction *tr, void const *source,
+                void *target, size_t size) {
+  void *copy = word_read_copy(reg, target);
+
+  if (tr->undo_size + size > tr->undo_capacity) {
+    size_t capacity = tr->undo_capacity == 0 ? 64 * reg->align
+                                             : 2 * tr->undo_capacity;
+
+    while (capacity < tr->undo_size + size) {
+      capacity *= 2;
+    }
+
+    char *values = realloc(tr->undo_values, capacity);
+
+    if (unlikely(values == NULL)) {
+      stats_abort(reg, tm_abort_nomem, NULL);
+      return false;
+    }
+
+    tr->undo_values = values;
+    tr->undo_capacity = capacity;
+  }
+
+  struct Undo undo = {.address = copy, .size = size};
+
+  memcpy(tr->undo_values + tr->undo_size, copy, size);
+  tr->undo_size += size;
+  insert_list(&tr->undo, undo, struct Undo);
+
+  memcpy(copy, source, size);
+
+  return true;
+}
+
+// Restore the written ranges, latest write first
+void undo_solo(struct Transaction *tr) {
+  size_t offset = tr->undo_size;
+
+  for (size_t i = tr->undo.n; i-- > 0;) {
+    struct Undo *undo = &get_list(&tr->undo, i, struct Undo);
+
+    offset -= undo->size;
+    memcpy(undo->address, tr->undo_values + offset, undo->size);
+  }
 }
 
 void commit(shared_t shared) {
   struct Region *reg = (struct Region *)shared;
   struct Control *control = NULL;
 
+  probe3(epoch_start, reg, (size_t)reg->batcher.epoch,
+         reg->modified_controls.n);
+  trace(reg, TRACE_EPOCH_START, MODE_BATCHER);
+
   for (size_t i = 0; i < reg->modified_controls.n; ++i) {
     control = get_list(&reg->modified_controls, i, struct Control *);
 
-    if (ACS_TYPE(control->access_type_id)) {
-      memcpy(control->read_word, control->write_word, reg->align);
+    if (ACS_IS_ADD(control->access_type_id)) {
+      size_t width = ACS_ID(control->access_type_id);
+
+      add_int(control_read_copy(reg, control),
+              (int64_t)load_int(control_write_copy(reg, control), width),
+              width);
+    } else if (ACS_TYPE(control->access_type_id)) {
+      memcpy(control_read_copy(reg, control), control_write_copy(reg, control),
+             reg->align);
     }
 
     control->access_type_id = ACS_NULL;
     control->accessed_epoch = 0;
     control->accessed_write = 0;
+#if !USE_VMEM
     control->saved = 0;
+#endif
     control->tx_read = 0;
   }
 
@@ -171,8 +373,12 @@ void commit(shared_t shared) {
 
   for (size_t i = 0; i < reg->freed_segments.n; ++i) {
     uintptr_t index = get_list(&reg->freed_segments, i, uintptr_t);
-    seg_free(shared, index);
+    seg_free(reg, index);
   }
 
   reg->freed_segments.n = 0;
-}
\ No newline at end of file
+
+  stats_add(reg, STAT_EPOCHS, 1);
+  trace(reg, TRACE_EPOCH_END, MODE_BATCHER);
+  probe2(epoch_end, reg, (size_t)reg->batcher.epoch);
+}
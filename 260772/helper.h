@@ -5,15 +5,18 @@
 #include <unistd.h>
 
 #include "batcher.h"
+#include "config.h"
+#include "options.h"
 #include "simple_list.h"
 #include "tm.h"
 
 #define MAX_SEGMENTS 65536
+#if !USE_VMEM
 // We need the -1, because the first segment has address at 1 to avoid having
 // NULL as an address
 #define SEGMENT_INDEX(X) ((((uintptr_t)(X)) >> 48) - 1)
-#define WORD_INDEX(X)                                                          \
-  ((((uintptr_t)(X)) & 0xffffffffffff) / (((struct Region *)shared)->align))
+#define WORD_OFFSET(X) (((uintptr_t)(X)) & 0xffffffffffff)
+#endif
 
 // For the whole encoding
 #define ACS_NULL 0
@@ -45,9 +48,21 @@
 #define ACS_CREATE(id, write_ability, type, accessed)                          \
   (((id) << 3) | ((write_ability) << 2) | ((type) << 1) | (accessed))
 
+// Transaction ids are stored above the 3 ACS bits, so they are taken modulo
+// (TX_ID_MASK + 1). Ids only need to be unique among the transactions of one
+// epoch, which are far fewer.
+#define TX_ID_MASK (SIZE_MAX >> 3)
+
 #define ACS_FIRST_READ 0b001
 #define ACS_MORE_READ 0b101
 
+// Commutative additions (tm_add) of width-byte integers: the write copy sums
+// the deltas of the committed adders of the epoch, added to the read copy at
+// commit. The write ability and type bits are never both set otherwise.
+#define ACS_ADD_INIT 0b110 // While the write copy is being zeroed
+#define ACS_ADD(width) (((acs)(width) << 3) | 0b111)
+#define ACS_IS_ADD(x) (((x)&0b111) == 0b111)
+
 
 
 typedef atomic_size_t atomic_acs;
@@ -65,28 +80,94 @@ struct Control {
   // atomic_size_t written;        // has been written in current epoch
   // size_t aborted; // If the thread that has written aborted in the current
   // epoch atomic_short accessed;
-  bool saved;            // was the action save on the tx list
   bool accessed_write;   // Was the write accessed
   atomic_size_t tx_read; // first tx that read the
+#if !USE_VMEM
+  bool saved; // was the action save on the tx list
   void *write_word;
   void *read_word;
+#endif
   atomic_acs access_type_id;
 };
 
 struct Region {
   struct Batcher batcher;
-  void *segments_write[MAX_SEGMENTS];     // Segment at index 0 is reserved
-  void *segments_read[MAX_SEGMENTS];      // Segment copy
-  struct Control *controls[MAX_SEGMENTS]; // Fixed array of array of control
-  atomic_size_t n_segments;
+
+  // Read-mostly, read at every access
+  cache_aligned struct Options options;
+#if USE_VMEM
+  char *base;               // Start of the reservation, i.e. of the write copies
+  size_t plane_size;        // Size of the write copies, read copies follow them
+  struct Control *controls; // One control per word of the write copies
+  size_t reserved;          // Size of the whole reservation (in bytes)
+  unsigned int align_shift; // log2 of the alignment
+  unsigned int slot_shift;  // log2 of the size of a segment slot
+  size_t page_size;         // Size of a regular page
+#endif
+  size_t align; // Claimed alignment of the shared memory region (in bytes)
+  enum Mode mode; // Current mode, only changed with the gate held exclusively
+#if USE_PROFILE
+  struct Profile *profile; // Contention profiler (profile.h), NULL if off
+#endif
+
+  // MODE_LOCK
+  cache_aligned pthread_rwlock_t lock;
+
+  // MODE_OPTIMISTIC sequence lock, odd while a writer writes back
+  cache_aligned atomic_uint_fast64_t seq;
+
+  // Mode switching (options.adaptive only). Transactions hold the gate shared,
+  // a switch takes it exclusively, i.e. once the in-flight ones are drained.
+  cache_aligned pthread_rwlock_t gate;
+  atomic_size_t ended;         // Transactions ended in the current window
+  atomic_size_t aborted;       // Transactions aborted in the current window
+  atomic_size_t in_flight;     // Transactions running
+  atomic_size_t max_in_flight; // Most transactions running in the window
+  atomic_bool switching;       // A thread is switching the mode
+
+  // Contention manager: starving transactions, one at a time (CM_SERIALIZE)
+  cache_aligned pthread_mutex_t serial;
+
+#if USE_STATS
+  // Counters (stats.h), one block per thread
+  cache_aligned pthread_mutex_t stats_lock;
+  struct ThreadStats *stats;
+  uint_fast64_t stats_id; // Unique among the regions ever created
+  uint64_t stats_ticks;   // Time stamp (stats_now) at creation
+  uint64_t stats_ns;      // Same, in nanoseconds
+#endif
+
+#if USE_TRACE
+  // Timeline (trace.h), one ring per thread, if traced
+  cache_aligned char *trace_path; // File to write it to, NULL if not traced
+  uint_fast64_t trace_id;         // Unique among the regions ever created
+  pthread_mutex_t trace_lock;
+  struct TraceRing *traces;
+  uint64_t trace_ticks; // Time stamp (stats_now) at creation
+  uint64_t trace_ns;    // Same, in nanoseconds
+#endif
+
+  // Written at every read-write commit
+  cache_aligned pthread_mutex_t modified_controls_lock;
   struct List modified_controls; // ptr to modified control
-  pthread_mutex_t modified_controls_lock;
 
+  // Written at allocations and frees
+  cache_aligned atomic_size_t n_segments; // Slots ever handed out, next slot
+                                          // to hand out
   struct List freed_segments;
   pthread_mutex_t freed_segments_lock;
-  size_t size[MAX_SEGMENTS]; // Size of the segments (in bytes), mult.
-                             // of align
-  size_t align; // Claimed alignment of the shared memory region (in bytes)
+  struct List free_slots; // Index of freed segments whose slots can be reused
+  pthread_mutex_t free_slots_lock;
+
+  cache_aligned size_t size[MAX_SEGMENTS]; // Size of the segments (in bytes),
+                                           // mult. of align
+  size_t owner[MAX_SEGMENTS]; // Per slot, id of the batcher transaction that
+                              // allocated its segment, 0 if none
+#if !USE_VMEM
+  void *segments_write[MAX_SEGMENTS];     // Segment at index 0 is reserved
+  void *segments_read[MAX_SEGMENTS];      // Segment copy
+  struct Control *controls[MAX_SEGMENTS]; // Fixed array of array of control
+#endif
 };
 
 struct Transaction {
@@ -101,24 +182,47 @@ struct Transaction {
   struct List accessed_words;
   struct List alloced_segments; // index of segment (uintptr_t)
   struct List freed_segments;   // index of segment (uintptr_t)
+
+  struct List adds; // struct Add, applied at commit
+
+  // Alone in its epoch (USE_SOLO): writes in place, no controls
+  bool solo;
+  bool irrevocable; // Holds an epoch of its own (enter_exclusive), and solo
+  struct List undo;  // struct Undo, one per write, oldest first
+  char *undo_values; // Previous values of the written ranges, back to back
+  size_t undo_size;  // Bytes used in undo_values
+  size_t undo_capacity;
+};
+
+// Delta to add to the sum of an ACS_ADD word at commit
+struct Add {
+  void *sum; // Write copy
+  int64_t delta;
+  size_t width;
+};
+
+// Range of read copy overwritten by a solo transaction
+struct Undo {
+  void *address; // Read copy
+  size_t size;
 };
 
-uintptr_t next_free(struct Region *reg);
 // void *choose_copy(shared_t shared, size_t segment_index, size_t index,
 //                   bool writeable, bool valid);
-// void read_word_at_index(shared_t shared, void *target, size_t segment_index,
-//                         size_t word_index, bool writeable, bool valid);
-bool read_word(struct Region *reg, tx_t tx, void *target, size_t segment_index,
-               size_t word_index, acs access_type_id);
-// void write_word_at_index(shared_t shared, void const *source,
-//                          size_t segment_index, size_t word_index, bool
-//                          valid);
-bool write_word(struct Region *reg, tx_t tx, void const *source,
-                size_t segment_index, size_t index, acs access_type_id);
-void seg_free(shared_t shared, uintptr_t index);
-// void realloc_size_t_array(size_t **array, size_t *size);
-// void insert_segment_array(size_t **array, size_t *size, size_t *n,
-//                           size_t index);
+bool read_word(struct Region *reg, tx_t tx, void *target, void const *source,
+               acs access_type_id);
+bool write_word(struct Region *reg, tx_t tx, void const *source, void *target,
+                acs access_type_id);
+bool add_word(struct Region *reg, struct Transaction *tr, void *target,
+              int64_t delta, size_t width, acs access_type_id);
+void add_int(void *target, int64_t delta, size_t width);
+void add_int_atomic(void *target, int64_t delta, size_t width);
+void read_solo(struct Region *reg, void *target, void const *source,
+               size_t size);
+bool write_solo(struct Region *reg, struct Transaction *tr, void const *source,
+                void *target, size_t size);
+void undo_solo(struct Transaction *tr);
+size_t tx_id(void);
 void commit(shared_t shared);
 
-void printBits(unsigned int num);
\ No newline at end of file
+void printBits(unsigned int num);
@@ -0,0 +1,73 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <string.h>
+
+#include "modes.h"
+#include "segment.h"
+
+// One reader-writer lock for the whole region, like reference/: read-only
+// transactions share it, a read-write transaction holds it alone. Words are
+// read and written in place, in their read copy, and no transaction aborts.
+
+static const tx_t read_write_tx = UINTPTR_MAX - 11;
+
+void lock_init(struct Region *reg) { pthread_rwlock_init(&reg->lock, NULL); }
+
+void lock_destroy(struct Region *reg) { pthread_rwlock_destroy(&reg->lock); }
+
+tx_t lock_begin(struct Region *reg, bool is_ro) {
+  if (is_ro) {
+    if (unlikely(pthread_rwlock_rdlock(&reg->lock) != 0)) {
+      return invalid_tx;
+    }
+    return read_only_tx;
+  }
+
+  if (unlikely(pthread_rwlock_wrlock(&reg->lock) != 0)) {
+    return invalid_tx;
+  }
+  return read_write_tx;
+}
+
+bool lock_end(struct Region *reg, tx_t unused(tx)) {
+  pthread_rwlock_unlock(&reg->lock);
+  return true;
+}
+
+// The read copy of a range of a segment is contiguous
+bool lock_read(struct Region *reg, tx_t unused(tx), void const *source,
+               size_t size, void *target) {
+  memcpy(target, word_read_copy(reg, source), size);
+  return true;
+}
+
+bool lock_write(struct Region *reg, tx_t unused(tx), void const *source,
+                size_t size, void *target) {
+  memcpy(word_read_copy(reg, target), source, size);
+  return true;
+}
+
+bool lock_add(struct Region *reg, tx_t unused(tx), void *target,
+              int64_t delta, size_t width) {
+  add_int(word_read_copy(reg, target), delta, width);
+  return true;
+}
+
+alloc_t lock_alloc(struct Region *reg, tx_t unused(tx), size_t size,
+                   void **target) {
+  uintptr_t index;
+
+  if (unlikely(!seg_alloc(reg, size, 0, &index))) {
+    return nomem_alloc;
+  }
+
+  *target = seg_address(reg, index);
+
+  return success_alloc;
+}
+
+// No other transaction runs, the segment can go at once
+bool lock_free(struct Region *reg, tx_t unused(tx), void *target) {
+  seg_free(reg, seg_index(reg, target));
+  return true;
+}
@@ -34,3 +34,14 @@
     #define unused(variable)
     #warning This compiler has no support for GCC attributes
 #endif
+
+/** Define a thread-local variable as reached without a call to the dynamic
+ * loader (initial-exec model), for variables read on every access.
+**/
+#undef initial_exec
+#ifdef __GNUC__
+    #define initial_exec \
+        __attribute__((tls_model("initial-exec")))
+#else
+    #define initial_exec
+#endif
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "helper.h"
+
+// Modes other than the batcher (see enum Mode), each implementing the tm_*
+// transaction functions. tm.c dispatches to them on reg->mode.
+
+// MODE_LOCK (lock.c)
+void lock_init(struct Region *reg);
+void lock_destroy(struct Region *reg);
+tx_t lock_begin(struct Region *reg, bool is_ro);
+bool lock_end(struct Region *reg, tx_t tx);
+bool lock_read(struct Region *reg, tx_t tx, void const *source, size_t size,
+               void *target);
+bool lock_write(struct Region *reg, tx_t tx, void const *source, size_t size,
+                void *target);
+bool lock_add(struct Region *reg, tx_t tx, void *target, int64_t delta,
+              size_t width);
+alloc_t lock_alloc(struct Region *reg, tx_t tx, size_t size, void **target);
+bool lock_free(struct Region *reg, tx_t tx, void *target);
+
+// MODE_OPTIMISTIC (optimistic.c)
+tx_t opt_begin(struct Region *reg, bool is_ro, bool irrevocable);
+bool opt_end(struct Region *reg, tx_t tx);
+void opt_abort(struct Region *reg, tx_t tx);
+bool opt_read(struct Region *reg, tx_t tx, void const *source, size_t size,
+              void *target);
+bool opt_write(struct Region *reg, tx_t tx, void const *source, size_t size,
+               void *target);
+bool opt_add(struct Region *reg, tx_t tx, void *target, int64_t delta,
+             size_t width);
+alloc_t opt_alloc(struct Region *reg, tx_t tx, size_t size, void **target);
+bool opt_free(struct Region *reg, tx_t tx, void *target);
+
+// Mode switching (adaptive.c). Every transaction enters before it begins, and
+// leaves once it committed or aborted; both are no-ops unless adaptive.
+void mode_init(struct Region *reg);
+void mode_destroy(struct Region *reg);
+enum Mode mode_enter(struct Region *reg);
+void mode_leave(struct Region *reg, bool committed);
@@ -0,0 +1,65 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "numa.h"
+
+// From <numaif.h>, not to depend on libnuma
+#define MPOL_PREFERRED 1
+#define MPOL_INTERLEAVE 3
+
+unsigned long numa_online_nodes(void) {
+  FILE *file = fopen("/sys/devices/system/node/online", "r");
+  unsigned long mask = 0;
+  unsigned int first, last;
+
+  if (file != NULL) {
+    // "0-1,3" format
+    while (fscanf(file, "%u", &first) == 1) {
+      last = first;
+      if (fscanf(file, "-%u", &last) < 0) {
+        break;
+      }
+      for (unsigned int node = first; node <= last && node < NUMA_MAX_NODES;
+           ++node) {
+        mask |= 1ul << node;
+      }
+      if (fgetc(file) != ',') {
+        break;
+      }
+    }
+    fclose(file);
+  }
+
+  return mask == 0 ? 1 : mask;
+}
+
+static void mbind_range(void *address, size_t length, int mode,
+                        unsigned long mask) {
+  syscall(SYS_mbind, address, length, mode, &mask, NUMA_MAX_NODES + 1, 0);
+}
+
+void numa_place_segment(struct Options const *options, void *address,
+                        size_t length, uintptr_t index) {
+  switch (options->numa) {
+  case NUMA_INTERLEAVE:
+    mbind_range(address, length, MPOL_INTERLEAVE, options->numa_online);
+    break;
+  case NUMA_NODES:
+    mbind_range(address, length, MPOL_PREFERRED,
+                1ul << options->numa_nodes[index % options->numa_n_nodes]);
+    break;
+  default:
+    break;
+  }
+}
+
+void numa_place_home(struct Options const *options, void *address,
+                     size_t length) {
+  if (options->numa == NUMA_NODES) {
+    mbind_range(address, length, MPOL_PREFERRED,
+                1ul << options->numa_nodes[0]);
+  }
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "options.h"
+
+// Placement of memory on NUMA nodes, following the policy of the options.
+// Errors (e.g. a kernel without NUMA support) leave the default placement.
+
+// Mask of the online nodes
+unsigned long numa_online_nodes(void);
+
+void numa_place_segment(struct Options const *options, void *address,
+                        size_t length, uintptr_t index);
+void numa_place_home(struct Options const *options, void *address,
+                     size_t length);
@@ -0,0 +1,483 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "modes.h"
+#include "profile.h"
+#include "segment.h"
+#include "stats.h"
+
+// NOrec: one global sequence lock (reg->seq), reads validated by value and a
+// redo log written back at commit with the sequence lock held. Committed words
+// are in their read copy, as in the other modes, and the controls are unused.
+// An irrevocable transaction holds the sequence lock from begin to end, and
+// reads and writes in place like MODE_LOCK: the others wait for it.
+
+#define INDEX_INIT_BITS 8
+
+struct OptTransaction {
+  struct Region *reg;
+  uint_fast64_t snapshot; // Even value of the sequence lock the reads match
+  bool in_use;            // Is the cached transaction of its thread, and running
+  bool irrevocable;       // Holds the sequence lock (snapshot + 1)
+
+  // Read log: the i-th read word (void const *) had value values + i * align
+  struct List reads;
+  char *values;
+  size_t values_size; // Capacity of values (in bytes)
+
+  // Redo log: the i-th written word (void *) has its value at data + i * align
+  struct List writes;
+  char *data;
+  size_t data_size;        // Capacity of data (in bytes)
+  uint32_t *index;         // Open-addressing index of writes, holding (i + 1)
+  unsigned int index_bits; // log2 of the number of index entries
+
+  struct List adds; // struct OptAdd, applied with the writes
+
+  struct List alloced_segments; // index of segment (uintptr_t)
+  struct List freed_segments;   // index of segment (uintptr_t)
+};
+
+// Commutative addition (tm_add): nothing read, nothing to validate
+struct OptAdd {
+  void *target;
+  int64_t delta;
+  size_t width;
+};
+
+// Transaction of the calling thread, reused from one transaction to the next
+// so that its logs keep their capacity. Freed when the thread exits.
+static _Thread_local struct OptTransaction *cached_tx = NULL;
+static pthread_key_t cached_tx_key;
+static pthread_once_t cached_tx_once = PTHREAD_ONCE_INIT;
+
+static struct OptTransaction *tx_create(void) {
+  struct OptTransaction *tx =
+      (struct OptTransaction *)calloc(1, sizeof(struct OptTransaction));
+
+  if (unlikely(tx == NULL)) {
+    return NULL;
+  }
+
+  init_list(&tx->reads, sizeof(void const *));
+  init_list(&tx->writes, sizeof(void *));
+  init_list(&tx->adds, sizeof(struct OptAdd));
+  init_list(&tx->alloced_segments, sizeof(uintptr_t));
+  init_list(&tx->freed_segments, sizeof(uintptr_t));
+
+  return tx;
+}
+
+static void tx_destroy(void *arg) {
+  struct OptTransaction *tx = (struct OptTransaction *)arg;
+
+  destroy_list(&tx->reads);
+  destroy_list(&tx->writes);
+  destroy_list(&tx->adds);
+  destroy_list(&tx->alloced_segments);
+  destroy_list(&tx->freed_segments);
+  free(tx->values);
+  free(tx->data);
+  free(tx->index);
+  free(tx);
+}
+
+static void cached_tx_init(void) {
+  pthread_key_create(&cached_tx_key, tx_destroy);
+}
+
+// Wait for the sequence lock to be free, and return it
+static uint_fast64_t snapshot(struct Region *reg) {
+  uint_fast64_t seq = atomic_load(&reg->seq);
+
+  while (seq & 1) {
+    sched_yield();
+    seq = atomic_load(&reg->seq);
+  }
+
+  return seq;
+}
+
+tx_t opt_begin(struct Region *reg, bool unused(is_ro), bool irrevocable) {
+  struct OptTransaction *tx = cached_tx;
+
+  // A thread running transactions on several regions at once gets a fresh
+  // transaction for all but the first one
+  if (unlikely(tx == NULL || tx->in_use)) {
+    tx = tx_create();
+
+    if (unlikely(tx == NULL)) {
+      return invalid_tx;
+    }
+
+    if (cached_tx == NULL) {
+      pthread_once(&cached_tx_once, cached_tx_init);
+      pthread_setspecific(cached_tx_key, tx);
+      cached_tx = tx;
+    }
+  }
+
+  tx->reg = reg;
+  tx->in_use = tx == cached_tx;
+  tx->irrevocable = irrevocable;
+  tx->snapshot = snapshot(reg);
+
+  while (irrevocable &&
+         !atomic_compare_exchange_weak(&reg->seq, &tx->snapshot,
+                                       tx->snapshot + 1)) {
+    tx->snapshot = snapshot(reg);
+  }
+
+  return (tx_t)tx;
+}
+
+static void tx_release(struct OptTransaction *tx) {
+  if (tx->writes.n > 0) {
+    memset(tx->index, 0, sizeof(uint32_t) << tx->index_bits);
+  }
+
+  tx->reads.n = 0;
+  tx->writes.n = 0;
+  tx->adds.n = 0;
+  tx->alloced_segments.n = 0;
+  tx->freed_segments.n = 0;
+
+  if (tx == cached_tx) {
+    tx->in_use = false;
+  } else {
+    tx_destroy(tx);
+  }
+}
+
+// The allocated segments may be reached by transactions reading slots they
+// had before, retire them rather than unmapping them
+static void tx_abort(struct OptTransaction *tx) {
+  for (size_t i = 0; i < tx->alloced_segments.n; ++i) {
+    seg_retire(tx->reg, get_list(&tx->alloced_segments, i, uintptr_t));
+  }
+
+  tx_release(tx);
+}
+
+// Make room for one more word in the given log values
+static bool values_grow(char **values, size_t *size, size_t n, size_t align) {
+  if ((n + 1) * align > *size) {
+    size_t new_size = *size == 0 ? 64 * align : 2 * *size;
+    char *new_values = realloc(*values, new_size);
+
+    if (unlikely(new_values == NULL)) {
+      return false;
+    }
+
+    *values = new_values;
+    *size = new_size;
+  }
+
+  return true;
+}
+
+static inline size_t write_hash(struct OptTransaction *tx,
+                                void const *target) {
+  return (((uintptr_t)target / tx->reg->align) *
+          UINT64_C(0x9E3779B97F4A7C15)) >>
+         (64 - tx->index_bits);
+}
+
+// Index of the redo log entry of the given word, -1 if not written
+static ssize_t write_find(struct OptTransaction *tx, void const *target) {
+  size_t mask = ((size_t)1 << tx->index_bits) - 1;
+
+  for (size_t slot = write_hash(tx, target);; slot = (slot + 1) & mask) {
+    uint32_t entry = tx->index[slot];
+
+    if (entry == 0) {
+      return -1;
+    }
+    if (get_list(&tx->writes, entry - 1, void *) == target) {
+      return entry - 1;
+    }
+  }
+}
+
+static void write_index(struct OptTransaction *tx, size_t i) {
+  size_t mask = ((size_t)1 << tx->index_bits) - 1;
+  size_t slot = write_hash(tx, get_list(&tx->writes, i, void *));
+
+  while (tx->index[slot] != 0) {
+    slot = (slot + 1) & mask;
+  }
+
+  tx->index[slot] = i + 1;
+}
+
+// Keep the index at most half full
+static bool write_grow(struct OptTransaction *tx) {
+  if (unlikely(!values_grow(&tx->data, &tx->data_size, tx->writes.n,
+                            tx->reg->align))) {
+    return false;
+  }
+
+  if (tx->index == NULL ||
+      2 * (tx->writes.n + 1) > ((size_t)1 << tx->index_bits)) {
+    unsigned int bits =
+        tx->index == NULL ? INDEX_INIT_BITS : tx->index_bits + 1;
+    uint32_t *index = calloc((size_t)1 << bits, sizeof(uint32_t));
+
+    if (unlikely(index == NULL)) {
+      return false;
+    }
+
+    free(tx->index);
+    tx->index = index;
+    tx->index_bits = bits;
+
+    for (size_t i = 0; i < tx->writes.n; ++i) {
+      write_index(tx, i);
+    }
+  }
+
+  return true;
+}
+
+// Check that every word read still has the value it was read with, at a time
+// no writer is writing back, which becomes the new snapshot
+static bool validate(struct OptTransaction *tx) {
+  struct Region *reg = tx->reg;
+
+  for (;;) {
+    uint_fast64_t seq = snapshot(reg);
+
+    for (size_t i = 0; i < tx->reads.n; ++i) {
+      void const *word = get_list(&tx->reads, i, void const *);
+
+      if (memcmp(word_read_copy(reg, word), tx->values + i * reg->align,
+                 reg->align) != 0) {
+        stats_abort(reg, tm_abort_validation, word);
+        profile(reg, word, PROFILE_CONFLICT);
+        return false;
+      }
+    }
+
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&reg->seq, memory_order_relaxed) == seq) {
+      tx->snapshot = seq;
+      return true;
+    }
+  }
+}
+
+static bool read_word_opt(struct OptTransaction *tx, void const *source,
+                          void *target) {
+  struct Region *reg = tx->reg;
+  size_t align = reg->align;
+
+  if (tx->writes.n > 0) {
+    ssize_t i = write_find(tx, source);
+
+    if (i >= 0) {
+      memcpy(target, tx->data + i * align, align);
+      return true;
+    }
+  }
+
+  if (unlikely(!values_grow(&tx->values, &tx->values_size, tx->reads.n,
+                            align))) {
+    stats_abort(reg, tm_abort_nomem, NULL);
+    return false;
+  }
+
+  memcpy(target, word_read_copy(reg, source), align);
+
+  // A writer committed since the snapshot: the read is only consistent with
+  // the previous ones if these still hold
+  atomic_thread_fence(memory_order_acquire);
+  while (atomic_load_explicit(&reg->seq, memory_order_relaxed) !=
+         tx->snapshot) {
+    if (!validate(tx)) {
+      return false;
+    }
+
+    memcpy(target, word_read_copy(reg, source), align);
+    atomic_thread_fence(memory_order_acquire);
+  }
+
+  memcpy(tx->values + tx->reads.n * align, target, align);
+  insert_list(&tx->reads, source, void const *);
+
+  return true;
+}
+
+static bool write_word_opt(struct OptTransaction *tx, void const *source,
+                           void *target) {
+  size_t align = tx->reg->align;
+  ssize_t i = tx->writes.n > 0 ? write_find(tx, target) : -1;
+
+  if (i < 0) {
+    if (unlikely(!write_grow(tx))) {
+      stats_abort(tx->reg, tm_abort_nomem, NULL);
+      return false;
+    }
+
+    i = tx->writes.n;
+    insert_list(&tx->writes, target, void *);
+    write_index(tx, i);
+  }
+
+  memcpy(tx->data + i * align, source, align);
+
+  return true;
+}
+
+bool opt_end(struct Region *reg, tx_t tx) {
+  struct OptTransaction *tr = (struct OptTransaction *)tx;
+
+  // Writes are already in place
+  if (tr->irrevocable) {
+    atomic_store_explicit(&reg->seq, tr->snapshot + 2, memory_order_release);
+
+    for (size_t i = 0; i < tr->freed_segments.n; ++i) {
+      seg_retire(reg, get_list(&tr->freed_segments, i, uintptr_t));
+    }
+
+    tx_release(tr);
+    return true;
+  }
+
+  // Reads were consistent at the snapshot, nothing to publish
+  if (tr->writes.n == 0 && tr->adds.n == 0 && tr->freed_segments.n == 0) {
+    tx_release(tr);
+    return true;
+  }
+
+  // Take the sequence lock, as long as no other writer committed since the
+  // (revalidated) snapshot
+  uint_fast64_t seq = tr->snapshot;
+
+  while (!atomic_compare_exchange_strong(&reg->seq, &seq, tr->snapshot + 1)) {
+    if (!validate(tr)) {
+      tx_abort(tr);
+      return false;
+    }
+
+    seq = tr->snapshot;
+  }
+
+  for (size_t i = 0; i < tr->writes.n; ++i) {
+    memcpy(word_read_copy(reg, get_list(&tr->writes, i, void *)),
+           tr->data + i * reg->align, reg->align);
+  }
+  for (size_t i = 0; i < tr->adds.n; ++i) {
+    struct OptAdd *add = &get_list(&tr->adds, i, struct OptAdd);
+    add_int(word_read_copy(reg, add->target), add->delta, add->width);
+  }
+
+  atomic_store_explicit(&reg->seq, tr->snapshot + 2, memory_order_release);
+
+  for (size_t i = 0; i < tr->freed_segments.n; ++i) {
+    seg_retire(reg, get_list(&tr->freed_segments, i, uintptr_t));
+  }
+
+  tx_release(tr);
+
+  return true;
+}
+
+bool opt_read(struct Region *reg, tx_t tx, void const *source, size_t size,
+              void *target) {
+  struct OptTransaction *tr = (struct OptTransaction *)tx;
+
+  if (tr->irrevocable) {
+    memcpy(target, word_read_copy(reg, source), size);
+    return true;
+  }
+
+  for (size_t i = 0; i < size; i += reg->align) {
+    if (!read_word_opt(tr, (char const *)source + i, (char *)target + i)) {
+      tx_abort(tr);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool opt_write(struct Region *reg, tx_t tx, void const *source, size_t size,
+               void *target) {
+  struct OptTransaction *tr = (struct OptTransaction *)tx;
+
+  if (tr->irrevocable) {
+    memcpy(word_read_copy(reg, target), source, size);
+    return true;
+  }
+
+  for (size_t i = 0; i < size; i += reg->align) {
+    if (!write_word_opt(tr, (char const *)source + i, (char *)target + i)) {
+      tx_abort(tr);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool opt_add(struct Region *reg, tx_t tx, void *target, int64_t delta,
+             size_t width) {
+  struct OptTransaction *tr = (struct OptTransaction *)tx;
+
+  if (tr->irrevocable) {
+    add_int(word_read_copy(reg, target), delta, width);
+    return true;
+  }
+
+  ssize_t i = tr->writes.n > 0 ? write_find(tr, target) : -1;
+
+  // Written by this transaction: an addition like any other write
+  if (i >= 0) {
+    add_int(tr->data + i * reg->align, delta, width);
+    return true;
+  }
+
+  struct OptAdd add = {.target = target, .delta = delta, .width = width};
+
+  insert_list(&tr->adds, add, struct OptAdd);
+
+  return true;
+}
+
+// An irrevocable transaction already wrote in place, it can only end
+void opt_abort(struct Region *reg, tx_t tx) {
+  struct OptTransaction *tr = (struct OptTransaction *)tx;
+
+  if (tr->irrevocable) {
+    opt_end(reg, tx);
+  } else {
+    tx_abort(tr);
+  }
+}
+
+alloc_t opt_alloc(struct Region *reg, tx_t tx, size_t size, void **target) {
+  struct OptTransaction *tr = (struct OptTransaction *)tx;
+  uintptr_t index;
+
+  if (unlikely(!seg_alloc(reg, size, 0, &index))) {
+    return nomem_alloc;
+  }
+
+  *target = seg_address(reg, index);
+  insert_list(&tr->alloced_segments, index, uintptr_t);
+
+  return success_alloc;
+}
+
+bool opt_free(struct Region *reg, tx_t tx, void *target) {
+  struct OptTransaction *tr = (struct OptTransaction *)tx;
+
+  insert_list(&tr->freed_segments, seg_index(reg, target), uintptr_t);
+
+  return true;
+}
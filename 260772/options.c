@@ -0,0 +1,123 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "numa.h"
+#include "options.h"
+
+// Value of the given variable, NULL if unset or empty
+static char const *option(char const *name) {
+  char const *value = getenv(name);
+  return value == NULL || value[0] == '\0' ? NULL : value;
+}
+
+void options_load(struct Options *options) {
+  char const *value;
+
+  options->huge_pages = HUGE_PAGES_NONE;
+  if ((value = option("TM_HUGEPAGES")) != NULL) {
+    if (strcmp(value, "thp") == 0) {
+      options->huge_pages = HUGE_PAGES_THP;
+    } else if (strcmp(value, "explicit") == 0) {
+      options->huge_pages = HUGE_PAGES_EXPLICIT;
+    } else if (strcmp(value, "off") != 0) {
+      fprintf(stderr, "Warning: unknown TM_HUGEPAGES '%s', ignored\n", value);
+    }
+  }
+
+  options->numa = NUMA_FIRST_TOUCH;
+  options->numa_n_nodes = 0;
+  options->numa_online = 0;
+  if ((value = option("TM_NUMA")) != NULL) {
+    if (strcmp(value, "interleave") == 0) {
+      options->numa = NUMA_INTERLEAVE;
+      options->numa_online = numa_online_nodes();
+    } else if (strncmp(value, "nodes:", 6) == 0) {
+      char const *node = value + 6;
+      char *end;
+
+      while (options->numa_n_nodes < NUMA_MAX_NODES) {
+        unsigned long id = strtoul(node, &end, 10);
+
+        if (end == node || id >= NUMA_MAX_NODES) {
+          break;
+        }
+        options->numa_nodes[options->numa_n_nodes++] = (unsigned int)id;
+        if (*end != ',') {
+          break;
+        }
+        node = end + 1;
+      }
+
+      if (options->numa_n_nodes > 0) {
+        options->numa = NUMA_NODES;
+      } else {
+        fprintf(stderr, "Warning: no node in TM_NUMA '%s', ignored\n", value);
+      }
+    } else if (strcmp(value, "first-touch") != 0) {
+      fprintf(stderr, "Warning: unknown TM_NUMA '%s', ignored\n", value);
+    }
+  }
+
+  options->mode = MODE_BATCHER;
+  options->adaptive = false;
+  if ((value = option("TM_MODE")) != NULL) {
+    if (strcmp(value, "lock") == 0) {
+      options->mode = MODE_LOCK;
+    } else if (strcmp(value, "optimistic") == 0) {
+      options->mode = MODE_OPTIMISTIC;
+    } else if (strcmp(value, "adaptive") == 0) {
+      options->adaptive = true;
+    } else if (strcmp(value, "batcher") != 0) {
+      fprintf(stderr, "Warning: unknown TM_MODE '%s', ignored\n", value);
+    }
+  }
+
+  options->contention = CM_BACKOFF;
+  if ((value = option("TM_CM")) != NULL) {
+    if (strcmp(value, "none") == 0) {
+      options->contention = CM_NONE;
+    } else if (strcmp(value, "karma") == 0) {
+      options->contention = CM_KARMA;
+    } else if (strcmp(value, "serialize") == 0) {
+      options->contention = CM_SERIALIZE;
+    } else if (strcmp(value, "backoff") != 0) {
+      fprintf(stderr, "Warning: unknown TM_CM '%s', ignored\n", value);
+    }
+  }
+
+  options->irrevocable_after = IRREVOCABLE_AFTER;
+  if ((value = option("TM_IRREVOCABLE_AFTER")) != NULL) {
+    char *end;
+    unsigned long after = strtoul(value, &end, 10);
+
+    if (*end == '\0') {
+      options->irrevocable_after = (unsigned int)after;
+    } else {
+      fprintf(stderr, "Warning: invalid TM_IRREVOCABLE_AFTER '%s', ignored\n",
+              value);
+    }
+  }
+
+  options->stats = option("TM_STATS") != NULL;
+  if (!USE_STATS && options->stats) {
+    fprintf(stderr, "Warning: TM_STATS needs USE_STATS, ignored\n");
+    options->stats = false;
+  }
+  options->trace = option("TM_TRACE");
+
+  options->profile = 0;
+  if ((value = option("TM_PROFILE")) != NULL) {
+    char *end;
+    unsigned long period = strtoul(value, &end, 10);
+
+    if (*end == '\0' && period > 0) {
+      options->profile = (unsigned int)period;
+    } else {
+      fprintf(stderr, "Warning: invalid TM_PROFILE '%s', ignored\n", value);
+    }
+  }
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdbool.h>
+
+// Run-time options of a shared memory region, read from the environment when
+// the region is created.
+
+// How the copies and controls of the segments are backed (TM_HUGEPAGES)
+enum HugePages {
+  HUGE_PAGES_NONE,     // "off": regular pages (default)
+  HUGE_PAGES_THP,      // "thp": transparent huge pages, madvise(MADV_HUGEPAGE)
+  HUGE_PAGES_EXPLICIT, // "explicit": MAP_HUGETLB, falls back to "thp" when
+                       // the huge page pool cannot back a segment
+};
+
+// Where the pages of the segments are placed (TM_NUMA)
+enum NumaPolicy {
+  NUMA_FIRST_TOUCH, // "first-touch": on the node of the first thread touching
+                    // them, i.e. the kernel default (default)
+  NUMA_INTERLEAVE,  // "interleave": page by page over all the online nodes
+  NUMA_NODES,       // "nodes:<n>[,<n>...]": segment i prefers the node at
+                    // position (i mod count) in the list, and the region
+                    // control block (batcher included) the first one
+};
+
+#define NUMA_MAX_NODES 64
+
+// How the transactions are synchronized (TM_MODE)
+enum Mode {
+  MODE_BATCHER,    // "batcher": epochs of the dual-versioned batcher (default)
+  MODE_LOCK,       // "lock": one reader-writer lock for the whole region
+  MODE_OPTIMISTIC, // "optimistic": one global sequence lock, redo log and
+                   // value-based validation of the reads (NOrec)
+};
+
+// What a thread does after its transaction aborted (TM_CM), see contention.h
+enum ContentionPolicy {
+  CM_NONE,      // "none": retry at once
+  CM_BACKOFF,   // "backoff": wait a random time, in a window doubling with
+                // each consecutive abort (default)
+  CM_KARMA,     // "karma": like "backoff", the window shrinking with the work
+                // done by the aborted attempts, which then retry first
+  CM_SERIALIZE, // "serialize": like "backoff", then after CM_SERIALIZE_AFTER
+                // consecutive aborts run one such transaction at a time
+};
+
+struct Options {
+  enum HugePages huge_pages;
+  enum NumaPolicy numa;
+  unsigned int numa_nodes[NUMA_MAX_NODES]; // For NUMA_NODES
+  size_t numa_n_nodes;
+  unsigned long numa_online; // Mask of the online nodes, for NUMA_INTERLEAVE
+  enum Mode mode;             // Initial mode
+  bool adaptive; // "adaptive": start as "batcher", then switch between the
+                 // modes from the measured abort rate and concurrency
+  enum ContentionPolicy contention;
+  unsigned int irrevocable_after; // Consecutive aborts after which the next
+                                  // attempt is irrevocable, 0 for never
+  bool stats; // Count (tm_stats), and print the counters of the region when
+              // it is destroyed
+  char const *trace; // File to write the timeline of the region to when it
+                     // is destroyed (TM_TRACE), NULL for none
+  unsigned int profile; // Profile the contended words, one event in that
+                        // many (TM_PROFILE), 0 for not at all
+};
+
+void options_load(struct Options *options);
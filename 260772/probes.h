@@ -0,0 +1,39 @@
+#pragma once
+
+#include "config.h"
+
+// Static probes (USDT) of provider "tm", for perf and bpftrace: each one is a
+// nop in the code and a note in the library, patched only while a tracer is
+// attached. Compiled in when USE_PROBES and <sys/sdt.h> (systemtap-sdt-dev)
+// are there, otherwise the arguments are not even evaluated.
+//
+//   begin(reg, is_ro, irrevocable)          tm_begin, before entering
+//   commit(reg, tx, mode)                   the transaction committed
+//   abort(reg, tx, mode)                    the transaction aborted
+//   wait_start(batcher, epoch, exclusive)   blocked to enter an epoch
+//   wait_end(batcher, epoch, exclusive)     entered
+//   epoch_start(reg, epoch, words)          commit() of the last to leave
+//   epoch_end(reg, epoch)
+//   alloc(reg, tx, size, result, address)   tm_alloc returned
+//   free(reg, tx, address, result)          tm_free returned
+//
+// e.g. bpftrace -l 'usdt:../260772.so:tm:*', scripts in bpftrace/.
+
+#if USE_PROBES && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define HAS_PROBES 1
+#endif
+#endif
+
+#ifdef HAS_PROBES
+#define probe2(name, a, b) DTRACE_PROBE2(tm, name, a, b)
+#define probe3(name, a, b, c) DTRACE_PROBE3(tm, name, a, b, c)
+#define probe4(name, a, b, c, d) DTRACE_PROBE4(tm, name, a, b, c, d)
+#define probe5(name, a, b, c, d, e) DTRACE_PROBE5(tm, name, a, b, c, d, e)
+#else
+#define probe2(name, a, b) ((void)sizeof(a), (void)sizeof(b))
+#define probe3(name, a, b, c) (probe2(name, a, b), (void)sizeof(c))
+#define probe4(name, a, b, c, d) (probe3(name, a, b, c), (void)sizeof(d))
+#define probe5(name, a, b, c, d, e) (probe4(name, a, b, c, d), (void)sizeof(e))
+#endif
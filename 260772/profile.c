@@ -0,0 +1,211 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "macros.h"
+#include "profile.h"
+#include "segment.h"
+
+#if USE_PROFILE
+
+_Static_assert((PROFILE_WIDTH & (PROFILE_WIDTH - 1)) == 0,
+               "PROFILE_WIDTH must be a power of 2");
+
+// Word among the most contended ones
+struct HotWord {
+  uint64_t key; // seg_key
+  uint64_t estimate;
+  uint64_t events[2]; // enum ProfileEvent
+};
+
+struct Profile {
+  cache_aligned atomic_uint_fast64_t sketch[PROFILE_DEPTH][PROFILE_WIDTH];
+
+  cache_aligned pthread_mutex_t top_lock;
+  struct HotWord top[PROFILE_TOP]; // Zeroed estimate if unused
+  atomic_uint_fast64_t least;      // Least estimate in top, to skip the lock
+                                   // for the words that cannot enter it
+};
+
+// Events the calling thread still skips before counting one
+static initial_exec _Thread_local unsigned int profile_skip = 0;
+
+// Odd multipliers, one per row of the sketch
+static uint64_t const seeds[] = {
+    0x9e3779b97f4a7c15, 0xc2b2ae3d27d4eb4f, 0x165667b19e3779f9,
+    0xd6e8feb86659fd93, 0xff51afd7ed558ccd, 0xc4ceb9fe1a85ec53,
+    0x94d049bb133111eb, 0xbf58476d1ce4e5b9,
+};
+
+_Static_assert(PROFILE_DEPTH <= sizeof(seeds) / sizeof(seeds[0]),
+               "PROFILE_DEPTH too large");
+
+static inline uint64_t seg_key(uintptr_t segment, size_t word) {
+  return ((uint64_t)segment << 40) | word;
+}
+
+void profile_init(struct Region *reg) {
+  reg->profile = NULL;
+
+  if (reg->options.profile == 0) {
+    return;
+  }
+
+  if (posix_memalign((void **)&reg->profile, CACHE_LINE_SIZE,
+                     sizeof(struct Profile)) != 0) {
+    reg->profile = NULL;
+    fprintf(stderr, "Warning: could not allocate the profiler\n");
+    return;
+  }
+
+  memset(reg->profile, 0, sizeof(struct Profile));
+  pthread_mutex_init(&reg->profile->top_lock, NULL);
+}
+
+void profile_destroy(struct Region *reg) {
+  if (reg->profile == NULL) {
+    return;
+  }
+
+  pthread_mutex_destroy(&reg->profile->top_lock);
+  free(reg->profile);
+}
+
+static void top_count(struct Profile *prof, uint64_t key, uint64_t estimate,
+                      enum ProfileEvent event, uint64_t weight) {
+  struct HotWord *least = &prof->top[0];
+  struct HotWord *word = NULL;
+
+  pthread_mutex_lock(&prof->top_lock);
+
+  for (size_t i = 0; i < PROFILE_TOP; ++i) {
+    if (prof->top[i].estimate > 0 && prof->top[i].key == key) {
+      word = &prof->top[i];
+      break;
+    }
+    if (prof->top[i].estimate < least->estimate) {
+      least = &prof->top[i];
+    }
+  }
+
+  if (word == NULL && estimate > least->estimate) {
+    word = least;
+    *word = (struct HotWord){.key = key};
+  }
+
+  if (word != NULL) {
+    word->estimate = estimate;
+    word->events[event] += weight;
+
+    uint64_t min = UINT64_MAX;
+
+    for (size_t i = 0; i < PROFILE_TOP; ++i) {
+      min = prof->top[i].estimate < min ? prof->top[i].estimate : min;
+    }
+
+    atomic_store_explicit(&prof->least, min, memory_order_relaxed);
+  }
+
+  pthread_mutex_unlock(&prof->top_lock);
+}
+
+void profile_count(struct Region *reg, void const *address,
+                   enum ProfileEvent event) {
+  struct Profile *prof = reg->profile;
+  uint64_t weight = reg->options.profile;
+
+  if (profile_skip > 0) {
+    --profile_skip;
+    return;
+  }
+
+  profile_skip = (unsigned int)weight - 1;
+
+  uintptr_t segment = seg_index(reg, address);
+  size_t word =
+      ((char const *)address - (char *)seg_address(reg, segment)) / reg->align;
+  uint64_t key = seg_key(segment, word);
+  uint64_t estimate = UINT64_MAX;
+
+  for (size_t i = 0; i < PROFILE_DEPTH; ++i) {
+    size_t column = (key * seeds[i]) >> (64 - __builtin_ctzll(PROFILE_WIDTH));
+    uint64_t count =
+        atomic_fetch_add_explicit(&prof->sketch[i][column], weight,
+                                  memory_order_relaxed) +
+        weight;
+
+    estimate = count < estimate ? count : estimate;
+  }
+
+  // The words that cannot enter the top skip its lock
+  if (estimate >= atomic_load_explicit(&prof->least, memory_order_relaxed)) {
+    top_count(prof, key, estimate, event, weight);
+  }
+}
+
+static int hot_compare(void const *a, void const *b) {
+  uint64_t estimate_a = ((struct tm_hot_word const *)a)->contention;
+  uint64_t estimate_b = ((struct tm_hot_word const *)b)->contention;
+
+  return (estimate_a < estimate_b) - (estimate_a > estimate_b);
+}
+
+size_t profile_top(struct Region *reg, struct tm_hot_word *words, size_t n) {
+  struct Profile *prof = reg->profile;
+  struct tm_hot_word top[PROFILE_TOP];
+  size_t count = 0;
+
+  if (prof == NULL) {
+    return 0;
+  }
+
+  pthread_mutex_lock(&prof->top_lock);
+
+  for (size_t i = 0; i < PROFILE_TOP; ++i) {
+    struct HotWord *word = &prof->top[i];
+
+    if (word->estimate == 0) {
+      continue;
+    }
+
+    top[count++] = (struct tm_hot_word){
+        .segment = word->key >> 40,
+        .offset = (word->key & (((uint64_t)1 << 40) - 1)) * reg->align,
+        .contention = word->estimate,
+        .conflicts = word->events[PROFILE_CONFLICT],
+        .cas_failures = word->events[PROFILE_CAS],
+    };
+  }
+
+  pthread_mutex_unlock(&prof->top_lock);
+
+  qsort(top, count, sizeof(struct tm_hot_word), hot_compare);
+
+  count = count < n ? count : n;
+  memcpy(words, top, count * sizeof(struct tm_hot_word));
+
+  return count;
+}
+
+void profile_print(struct Region *reg) {
+  struct tm_hot_word top[PROFILE_TOP];
+  size_t n = profile_top(reg, top, PROFILE_TOP);
+
+  fprintf(stderr, "tm: %zu most contended word(s), one event in %u counted\n",
+          n, reg->options.profile);
+
+  for (size_t i = 0; i < n; ++i) {
+    fprintf(stderr,
+            "tm: segment %zu + %zu: ~%lu, %lu conflict(s), %lu failed "
+            "CAS\n",
+            top[i].segment, top[i].offset, (unsigned long)top[i].contention,
+            (unsigned long)top[i].conflicts,
+            (unsigned long)top[i].cas_failures);
+  }
+}
+
+#endif
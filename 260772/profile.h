@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <tm.h>
+
+#include "helper.h"
+#include "macros.h"
+
+// Contention profiler of a region, for a run with TM_PROFILE set to a sampling
+// period: one in that many conflicts and failed compare-and-swaps on the
+// control of a word is counted, that many times, in a count-min sketch shared
+// by the threads. The words whose estimate tops the sketch are kept, with
+// their own counts from then on, for tm_profile and for the report printed
+// when the region is destroyed. Without USE_PROFILE, profiling compiles to
+// nothing and tm_profile returns 0.
+
+enum ProfileEvent {
+  PROFILE_CONFLICT, // The access aborts the transaction
+  PROFILE_CAS,      // A compare-and-swap on the control of the word failed
+};
+
+#if USE_PROFILE
+
+void profile_init(struct Region *reg);
+void profile_destroy(struct Region *reg);
+void profile_count(struct Region *reg, void const *address,
+                   enum ProfileEvent event);
+size_t profile_top(struct Region *reg, struct tm_hot_word *words, size_t n);
+void profile_print(struct Region *reg);
+
+// Only a profiled region pays more than a branch
+static inline void profile(struct Region *reg, void const *address,
+                           enum ProfileEvent event) {
+  if (unlikely(reg->profile != NULL)) {
+    profile_count(reg, address, event);
+  }
+}
+
+#else
+
+static inline void profile_init(struct Region *unused(reg)) {}
+static inline void profile_destroy(struct Region *unused(reg)) {}
+static inline size_t profile_top(struct Region *unused(reg),
+                                 struct tm_hot_word *unused(words),
+                                 size_t unused(n)) {
+  return 0;
+}
+static inline void profile_print(struct Region *unused(reg)) {}
+static inline void profile(struct Region *unused(reg),
+                           void const *unused(address),
+                           enum ProfileEvent unused(event)) {}
+
+#endif
@@ -0,0 +1,413 @@
+#define _GNU_SOURCE
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "numa.h"
+#include "segment.h"
+
+// Number of consecutive slots (i.e. indices) a segment of the given size uses
+static size_t seg_slots(struct Region *unused(reg), size_t unused(size)) {
+#if USE_VMEM
+  size_t slot = (size_t)1 << reg->slot_shift;
+  return size == 0 ? 1 : (size + slot - 1) >> reg->slot_shift;
+#else
+  return 1;
+#endif
+}
+
+// Take back slots of a freed segment of the same slot count, if any.
+static bool reuse_slots(struct Region *reg, size_t n, uintptr_t *index) {
+  bool found = false;
+
+  pthread_mutex_lock(&reg->free_slots_lock);
+  for (size_t i = 0; i < reg->free_slots.n; ++i) {
+    uintptr_t freed = get_list(&reg->free_slots, i, uintptr_t);
+
+    if (seg_slots(reg, reg->size[freed]) == n) {
+      *index = freed;
+      get_list(&reg->free_slots, i, uintptr_t) =
+          get_list(&reg->free_slots, reg->free_slots.n - 1, uintptr_t);
+      --reg->free_slots.n;
+      found = true;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&reg->free_slots_lock);
+
+  return found;
+}
+
+static void release_slots(struct Region *reg, uintptr_t index) {
+  pthread_mutex_lock(&reg->free_slots_lock);
+  insert_list(&reg->free_slots, index, uintptr_t);
+  pthread_mutex_unlock(&reg->free_slots_lock);
+}
+
+#if USE_VMEM
+
+// Huge pages only back segments of at least one huge page, smaller ones would
+// pay for zeroing a whole huge page per copy on each allocation.
+static size_t seg_page_size(struct Region *reg, size_t size) {
+  size_t huge_page_size = (size_t)1 << HUGE_PAGE_SHIFT;
+
+  if (reg->options.huge_pages != HUGE_PAGES_NONE && size >= huge_page_size) {
+    return huge_page_size;
+  }
+
+  return reg->page_size;
+}
+
+static size_t round_page(size_t size, size_t page_size) {
+  return (size + page_size - 1) & ~(page_size - 1);
+}
+
+static inline struct Control *seg_controls(struct Region *reg,
+                                           uintptr_t index) {
+  return reg->controls + (index << (reg->slot_shift - reg->align_shift));
+}
+
+static inline size_t seg_controls_size(struct Region *reg, size_t size) {
+  return round_page((size >> reg->align_shift) * sizeof(struct Control),
+                    seg_page_size(reg, size));
+}
+
+static bool range_map(struct Region *reg, void *address, size_t length,
+                      bool huge) {
+  if (huge && reg->options.huge_pages == HUGE_PAGES_EXPLICIT) {
+    if (mmap(address, length, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_HUGETLB, -1,
+             0) != MAP_FAILED) {
+      return true;
+    }
+
+    // Not enough huge pages in the pool. The failed mapping may have left a
+    // hole in the reservation, claim it back without clobbering anything.
+    void *hole = mmap(address, length, PROT_NONE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE |
+                          MAP_FIXED_NOREPLACE,
+                      -1, 0);
+
+    if (hole != MAP_FAILED && hole != address) {
+      munmap(hole, length);
+    }
+  }
+
+  if (mprotect(address, length, PROT_READ | PROT_WRITE) != 0) {
+    return false;
+  }
+
+  if (huge) {
+    madvise(address, length, MADV_HUGEPAGE);
+  }
+
+  return true;
+}
+
+// Replace the pages by a fresh reservation, so the slots read back as zeros
+// once reused, whatever backed them.
+static void range_unmap(void *address, size_t length) {
+  mmap(address, length, PROT_NONE,
+       MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_NORESERVE, -1, 0);
+}
+
+// Replace the pages by fresh zero pages in one step, so that a racing access
+// reads either the old contents or zeros, but never faults
+static void range_zero(void *address, size_t length) {
+  mmap(address, length, PROT_READ | PROT_WRITE,
+       MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+}
+
+static void seg_zero(struct Region *reg, uintptr_t index, size_t size) {
+  char *write_copy = seg_address(reg, index);
+  size_t length = round_page(size, seg_page_size(reg, size));
+
+  range_zero(write_copy, length);
+  range_zero(write_copy + reg->plane_size, length);
+  range_zero(seg_controls(reg, index), seg_controls_size(reg, size));
+}
+
+static bool seg_map(struct Region *reg, uintptr_t index, size_t size) {
+  char *write_copy = seg_address(reg, index);
+  size_t page_size = seg_page_size(reg, size);
+  size_t length = round_page(size, page_size);
+  bool huge = page_size != reg->page_size;
+
+  size_t controls_length = seg_controls_size(reg, size);
+
+  // On failure, the ranges already mapped go back to the reservation, so that
+  // the slots are released as they were taken
+  if (!range_map(reg, write_copy, length, huge)) {
+    return false;
+  }
+  if (!range_map(reg, write_copy + reg->plane_size, length, huge)) {
+    range_unmap(write_copy, length);
+    return false;
+  }
+  if (!range_map(reg, seg_controls(reg, index), controls_length, huge)) {
+    range_unmap(write_copy, length);
+    range_unmap(write_copy + reg->plane_size, length);
+    return false;
+  }
+
+  // Before any page is touched
+  numa_place_segment(&reg->options, write_copy, length, index);
+  numa_place_segment(&reg->options, write_copy + reg->plane_size, length,
+                     index);
+  numa_place_segment(&reg->options, seg_controls(reg, index), controls_length,
+                     index);
+
+  return true;
+}
+
+static void seg_unmap(struct Region *reg, uintptr_t index, size_t size) {
+  char *write_copy = seg_address(reg, index);
+  size_t length = round_page(size, seg_page_size(reg, size));
+
+  range_unmap(write_copy, length);
+  range_unmap(write_copy + reg->plane_size, length);
+  range_unmap(seg_controls(reg, index), seg_controls_size(reg, size));
+}
+
+// Reserve size bytes aligned on page_size
+static void *reserve(size_t size, size_t page_size) {
+  size_t slack = page_size - (size_t)sysconf(_SC_PAGESIZE);
+  char *area = mmap(NULL, size + slack, PROT_NONE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+  if (area == MAP_FAILED) {
+    return NULL;
+  }
+
+  char *base = (char *)(((uintptr_t)area + page_size - 1) & ~(page_size - 1));
+
+  if (base > area) {
+    munmap(area, base - area);
+  }
+  if (base + size < area + size + slack) {
+    munmap(base + size, area + size + slack - (base + size));
+  }
+
+  return base;
+}
+
+bool region_map(struct Region *reg, size_t size, size_t align) {
+  unsigned int align_shift = __builtin_ctzl(align);
+  size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+  unsigned int page_shift = reg->options.huge_pages == HUGE_PAGES_NONE
+                                ? __builtin_ctzl(page_size)
+                                : HUGE_PAGE_SHIFT;
+  // The controls of a slot must start on a page boundary so that slots can
+  // be (un)mapped independently
+  unsigned int min_shift = align_shift + page_shift;
+  unsigned int slot_shift =
+      VMEM_SLOT_SHIFT > min_shift ? VMEM_SLOT_SHIFT : min_shift;
+
+  for (; slot_shift >= min_shift; --slot_shift) {
+    size_t plane_size = (size_t)MAX_SEGMENTS << slot_shift;
+    size_t controls_size =
+        (plane_size >> align_shift) * sizeof(struct Control);
+    size_t reserved = 2 * plane_size + controls_size;
+
+    if (size > plane_size) {
+      break;
+    }
+
+    char *base = reserve(reserved, (size_t)1 << page_shift);
+
+    if (base != NULL) {
+      reg->base = base;
+      reg->plane_size = plane_size;
+      reg->controls = (struct Control *)(reg->base + 2 * plane_size);
+      reg->reserved = reserved;
+      reg->align_shift = align_shift;
+      reg->slot_shift = slot_shift;
+      reg->page_size = page_size;
+      return true;
+    }
+  }
+
+  // Retry without huge pages, whose slots are larger
+  if (reg->options.huge_pages != HUGE_PAGES_NONE) {
+    fprintf(stderr, "Warning: cannot reserve the region with huge pages\n");
+    reg->options.huge_pages = HUGE_PAGES_NONE;
+    return region_map(reg, size, align);
+  }
+
+  return false;
+}
+
+void region_unmap(struct Region *reg) { munmap(reg->base, reg->reserved); }
+
+void *seg_address(struct Region *reg, uintptr_t index) {
+  return reg->base + (index << reg->slot_shift);
+}
+
+uintptr_t seg_index(struct Region *reg, void const *address) {
+  return ((uintptr_t)address - (uintptr_t)reg->base) >> reg->slot_shift;
+}
+
+#else
+
+// Only transparent huge pages are supported by this layout, on segments of at
+// least one huge page.
+static void advise_huge_pages(struct Region *reg, void *address, size_t size) {
+  size_t huge_page_size = (size_t)1 << HUGE_PAGE_SHIFT;
+
+  if (reg->options.huge_pages != HUGE_PAGES_NONE && size >= huge_page_size) {
+    madvise(address, size & ~(huge_page_size - 1), MADV_HUGEPAGE);
+  }
+}
+
+static void seg_zero(struct Region *reg, uintptr_t index, size_t size) {
+  memset(reg->segments_write[index], 0, size);
+  memset(reg->segments_read[index], 0, size);
+  memset(reg->controls[index], 0, (size / reg->align) * sizeof(struct Control));
+}
+
+static bool seg_map(struct Region *reg, uintptr_t index, size_t size) {
+  size_t align = reg->align;
+
+  // Retired segment, whose memory was kept
+  if (reg->controls[index] != NULL) {
+    free(reg->segments_write[index]);
+    free(reg->segments_read[index]);
+    free(reg->controls[index]);
+  }
+
+  if (reg->options.huge_pages != HUGE_PAGES_NONE &&
+      size >= ((size_t)1 << HUGE_PAGE_SHIFT) &&
+      align < ((size_t)1 << HUGE_PAGE_SHIFT)) {
+    align = (size_t)1 << HUGE_PAGE_SHIFT;
+  }
+
+  reg->segments_write[index] = NULL;
+  reg->segments_read[index] = NULL;
+  reg->controls[index] = NULL;
+
+  if (unlikely(posix_memalign(&(reg->segments_write[index]), align, size) !=
+                   0 ||
+               posix_memalign(&(reg->segments_read[index]), align, size) !=
+                   0)) {
+    free(reg->segments_write[index]);
+    return false;
+  }
+
+  advise_huge_pages(reg, reg->segments_write[index], size);
+  advise_huge_pages(reg, reg->segments_read[index], size);
+
+  // Allocate control structre
+  reg->controls[index] =
+      (struct Control *)calloc(size / reg->align, sizeof(struct Control));
+
+  if (unlikely(reg->controls[index] == NULL)) {
+    free(reg->segments_write[index]);
+    free(reg->segments_read[index]);
+    return false;
+  }
+
+  memset(reg->segments_write[index], 0, size);
+  memset(reg->segments_read[index], 0, size);
+
+  return true;
+}
+
+static void seg_unmap(struct Region *reg, uintptr_t index,
+                      size_t unused(size)) {
+  free(reg->segments_write[index]);
+  free(reg->segments_read[index]);
+  free(reg->controls[index]);
+
+  // To indicate a free index
+  reg->segments_write[index] = NULL;
+  reg->segments_read[index] = NULL;
+  reg->controls[index] = NULL;
+}
+
+bool region_map(struct Region *reg, size_t unused(size),
+                size_t unused(align)) {
+  // Segments are touched by the allocating thread, they cannot be placed
+  if (reg->options.numa != NUMA_FIRST_TOUCH) {
+    fprintf(stderr, "Warning: TM_NUMA needs USE_VMEM, ignored\n");
+    reg->options.numa = NUMA_FIRST_TOUCH;
+  }
+
+  // Reusing a retired slot frees its arrays, which an optimistic reader may
+  // still be reading before it validates
+  if (reg->options.mode == MODE_OPTIMISTIC || reg->options.adaptive) {
+    fprintf(stderr, "Warning: TM_MODE '%s' needs USE_VMEM, batcher used\n",
+            reg->options.adaptive ? "adaptive" : "optimistic");
+    reg->options.mode = MODE_BATCHER;
+    reg->options.adaptive = false;
+  }
+
+  return true;
+}
+
+void region_unmap(struct Region *reg) {
+  for (size_t index = 0; index < reg->n_segments; ++index) {
+    if (reg->controls[index] != NULL) {
+      seg_unmap(reg, index, reg->size[index]);
+    }
+  }
+}
+
+// We add one because we start a 1, so that no segment is at NULL.
+void *seg_address(struct Region *unused(reg), uintptr_t index) {
+  return (void *)((index + 1) << 48);
+}
+
+uintptr_t seg_index(struct Region *unused(reg), void const *address) {
+  return SEGMENT_INDEX(address);
+}
+
+#endif
+
+// The owner is recorded in every slot of the segment, so that seg_index of any
+// address of the segment finds it
+bool seg_alloc(struct Region *reg, size_t size, size_t owner,
+               uintptr_t *index) {
+  size_t n = seg_slots(reg, size);
+
+  if (!reuse_slots(reg, n, index)) {
+    // Take the next never used slots, O(1) time
+    size_t next = atomic_load(&reg->n_segments);
+
+    do {
+      if (unlikely(next + n > MAX_SEGMENTS)) {
+        return false;
+      }
+    } while (!atomic_compare_exchange_weak(&reg->n_segments, &next, next + n));
+
+    *index = next;
+  }
+
+  reg->size[*index] = size;
+  for (size_t i = 0; i < n; ++i) {
+    reg->owner[*index + i] = owner;
+  }
+
+  if (unlikely(!seg_map(reg, *index, size))) {
+    release_slots(reg, *index);
+    return false;
+  }
+
+  return true;
+}
+
+void seg_free(struct Region *reg, uintptr_t index) {
+  seg_unmap(reg, index, reg->size[index]);
+  release_slots(reg, index);
+}
+
+// Free a segment that transactions may still be reading (MODE_OPTIMISTIC): its
+// memory stays mapped, zeroed, until its slots are reused. With !USE_VMEM,
+// its memory is only freed once its slot is reused.
+void seg_retire(struct Region *reg, uintptr_t index) {
+  seg_zero(reg, index, reg->size[index]);
+  release_slots(reg, index);
+}
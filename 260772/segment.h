@@ -0,0 +1,82 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "config.h"
+#include "helper.h"
+#include "macros.h"
+
+// Layout of the shared memory region. With USE_VMEM the region is one
+// reservation [write copies | read copies | controls]: a shared address is the
+// address of its write copy, and its read copy and control are found at a
+// fixed offset, without any table lookup. Segments are carved out of the
+// reservation in slots of (1 << slot_shift) bytes, the index of a segment is
+// the index of its first slot.
+
+bool region_map(struct Region *reg, size_t size, size_t align);
+void region_unmap(struct Region *reg);
+
+bool seg_alloc(struct Region *reg, size_t size, size_t owner,
+               uintptr_t *index);
+void seg_free(struct Region *reg, uintptr_t index);
+void seg_retire(struct Region *reg, uintptr_t index);
+void *seg_address(struct Region *reg, uintptr_t index);
+uintptr_t seg_index(struct Region *reg, void const *address);
+
+#if USE_VMEM
+
+static inline void *word_write_copy(struct Region *unused(reg),
+                                    void const *address) {
+  return (void *)address;
+}
+
+static inline void *word_read_copy(struct Region *reg, void const *address) {
+  return (char *)address + reg->plane_size;
+}
+
+static inline struct Control *word_control(struct Region *reg,
+                                           void const *address) {
+  return reg->controls +
+         (((uintptr_t)address - (uintptr_t)reg->base) >> reg->align_shift);
+}
+
+static inline void *control_write_copy(struct Region *reg,
+                                       struct Control *control) {
+  return reg->base + ((uintptr_t)(control - reg->controls) << reg->align_shift);
+}
+
+static inline void *control_read_copy(struct Region *reg,
+                                      struct Control *control) {
+  return (char *)control_write_copy(reg, control) + reg->plane_size;
+}
+
+#else
+
+static inline void *word_write_copy(struct Region *reg, void const *address) {
+  return (char *)reg->segments_write[SEGMENT_INDEX(address)] +
+         WORD_OFFSET(address);
+}
+
+static inline void *word_read_copy(struct Region *reg, void const *address) {
+  return (char *)reg->segments_read[SEGMENT_INDEX(address)] +
+         WORD_OFFSET(address);
+}
+
+static inline struct Control *word_control(struct Region *reg,
+                                           void const *address) {
+  return &reg->controls[SEGMENT_INDEX(address)]
+                       [WORD_OFFSET(address) / reg->align];
+}
+
+static inline void *control_write_copy(struct Region *unused(reg),
+                                       struct Control *control) {
+  return control->write_word;
+}
+
+static inline void *control_read_copy(struct Region *unused(reg),
+                                      struct Control *control) {
+  return control->read_word;
+}
+
+#endif
@@ -5,7 +5,7 @@
 
 void init_list(struct List *list, size_t size_object)
 {
-  list->array = calloc(INIT_NMEMB, sizeof(size_object));
+  list->array = calloc(INIT_NMEMB, size_object);
   list->nmemb = INIT_NMEMB;
   list->n = 0;
 }
@@ -0,0 +1,315 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "macros.h"
+#include "segment.h"
+#include "stats.h"
+
+#if USE_STATS
+
+// Regions ever created, so that a thread tells a region from a previous one
+// created at the same address
+static atomic_uint_fast64_t stats_regions = 0;
+
+initial_exec _Thread_local struct ThreadStats *stats_cached = NULL;
+initial_exec _Thread_local uint_fast64_t stats_cached_region = 0;
+
+initial_exec _Thread_local uint64_t stats_reads = 0;
+initial_exec _Thread_local uint64_t stats_writes = 0;
+initial_exec _Thread_local uint64_t stats_adds = 0;
+
+static char const *const mode_names[tm_modes] = {"batcher", "lock",
+                                                 "optimistic"};
+
+static char const *const reason_names[tm_abort_reasons] = {
+    "read-written", "write-read", "write-written",
+    "add",          "validation", "nomem",
+};
+
+void stats_init(struct Region *reg) {
+  pthread_mutex_init(&reg->stats_lock, NULL);
+  reg->stats = NULL;
+  reg->stats_id = atomic_fetch_add(&stats_regions, 1) + 1;
+  reg->stats_ticks = stats_now();
+  reg->stats_ns = stats_ns();
+}
+
+void stats_destroy(struct Region *reg) {
+  struct ThreadStats *next;
+
+  for (struct ThreadStats *block = reg->stats; block != NULL; block = next) {
+    next = block->next;
+#if ABORT_SITES > 0
+    pthread_mutex_destroy(&block->sites_lock);
+#endif
+    free(block);
+  }
+
+  pthread_mutex_destroy(&reg->stats_lock);
+}
+
+// Block of the calling thread on the region, linked on first use
+struct ThreadStats *stats_register(struct Region *reg) {
+  pthread_t self = pthread_self();
+  struct ThreadStats *block;
+
+  pthread_mutex_lock(&reg->stats_lock);
+
+  for (block = reg->stats; block != NULL; block = block->next) {
+    if (pthread_equal(block->owner, self)) {
+      break;
+    }
+  }
+
+  if (block == NULL &&
+      posix_memalign((void **)&block, CACHE_LINE_SIZE,
+                     sizeof(struct ThreadStats)) == 0) {
+    memset(block, 0, sizeof(struct ThreadStats));
+#if ABORT_SITES > 0
+    pthread_mutex_init(&block->sites_lock, NULL);
+#endif
+    block->owner = self;
+    block->next = reg->stats;
+    reg->stats = block;
+  }
+
+  pthread_mutex_unlock(&reg->stats_lock);
+
+  if (block != NULL) {
+    stats_cached = block;
+    stats_cached_region = reg->stats_id;
+  }
+
+  return block;
+}
+
+#if ABORT_SITES > 0
+
+static void site_count(struct ThreadStats *block, uintptr_t segment,
+                       size_t word) {
+  struct AbortSite *least = &block->sites[0];
+
+  for (size_t i = 0; i < ABORT_SITES; ++i) {
+    struct AbortSite *site = &block->sites[i];
+
+    if (site->count > 0 && site->segment == segment && site->word == word) {
+      ++site->count;
+      return;
+    }
+    if (site->count < least->count) {
+      least = site;
+    }
+  }
+
+  least->segment = segment;
+  least->word = word;
+  ++least->count;
+}
+
+#endif
+
+// Count an abort of the calling thread, caused by the word at the given address
+// (NULL if none)
+void stats_abort(struct Region *reg, enum tm_abort_reason reason,
+                 void const *address) {
+  if (!stats_enabled(reg)) {
+    return;
+  }
+
+  struct ThreadStats *block = stats_thread(reg);
+
+  if (unlikely(block == NULL)) {
+    return;
+  }
+
+  stats_add(reg, STAT_ABORTS + reason, 1);
+
+#if ABORT_SITES > 0
+  if (address != NULL) {
+    uintptr_t segment = seg_index(reg, address);
+    size_t word = ((char const *)address - (char *)seg_address(reg, segment)) /
+                  reg->align;
+
+    pthread_mutex_lock(&block->sites_lock);
+    site_count(block, segment, word);
+    pthread_mutex_unlock(&block->sites_lock);
+  }
+#else
+  (void)address;
+#endif
+}
+
+#if ABORT_SITES > 0
+
+static int site_compare(void const *a, void const *b) {
+  uint64_t count_a = ((struct AbortSite const *)a)->count;
+  uint64_t count_b = ((struct AbortSite const *)b)->count;
+
+  return (count_a < count_b) - (count_a > count_b);
+}
+
+// Sum the sites of a block into the n first of all
+static size_t sites_merge(struct AbortSite *all, size_t n,
+                          struct ThreadStats *block) {
+  pthread_mutex_lock(&block->sites_lock);
+
+  for (size_t i = 0; i < ABORT_SITES; ++i) {
+    struct AbortSite *site = &block->sites[i];
+    size_t j = 0;
+
+    if (site->count == 0) {
+      continue;
+    }
+
+    while (j < n && (all[j].segment != site->segment ||
+                     all[j].word != site->word)) {
+      ++j;
+    }
+
+    if (j == n) {
+      all[n++] = (struct AbortSite){
+          .segment = site->segment, .word = site->word, .count = 0};
+    }
+
+    all[j].count += site->count;
+  }
+
+  pthread_mutex_unlock(&block->sites_lock);
+
+  return n;
+}
+
+#endif
+
+// Counter of the whole block
+static uint64_t counter(struct ThreadStats *block, enum Stat stat) {
+  return atomic_load_explicit(&block->counters[stat], memory_order_relaxed);
+}
+
+bool stats_sum(struct Region *reg, struct tm_stats *stats, bool thread_only) {
+  if (!stats_enabled(reg)) {
+    return false;
+  }
+
+  struct ThreadStats *self = thread_only ? stats_thread(reg) : NULL;
+#if ABORT_SITES > 0
+  struct AbortSite *all = NULL;
+  size_t n = 0;
+#endif
+
+  memset(stats, 0, sizeof(struct tm_stats));
+
+  pthread_mutex_lock(&reg->stats_lock);
+
+  for (struct ThreadStats *block = reg->stats; block != NULL;
+       block = block->next) {
+    ++stats->threads;
+  }
+
+#if ABORT_SITES > 0
+  all = calloc(stats->threads * ABORT_SITES, sizeof(struct AbortSite));
+#endif
+
+  stats->threads = 0;
+
+  for (struct ThreadStats *block = reg->stats; block != NULL;
+       block = block->next) {
+    if (thread_only && block != self) {
+      continue;
+    }
+
+    ++stats->threads;
+
+    for (size_t i = 0; i < tm_modes; ++i) {
+      stats->begins[i] += counter(block, STAT_BEGINS + i);
+      stats->commits[i] += counter(block, STAT_COMMITS + i);
+    }
+    for (size_t i = 0; i < tm_abort_reasons; ++i) {
+      stats->aborts[i] += counter(block, STAT_ABORTS + i);
+    }
+
+    stats->reads += counter(block, STAT_READS);
+    stats->writes += counter(block, STAT_WRITES);
+    stats->adds += counter(block, STAT_ADDS);
+    stats->epochs += counter(block, STAT_EPOCHS);
+    stats->commit_ns += counter(block, STAT_COMMIT_NS);
+    stats->wait_ns += counter(block, STAT_WAIT_NS);
+    stats->irrevocable += counter(block, STAT_IRREVOCABLE);
+    stats->promoted += counter(block, STAT_PROMOTED);
+
+#if ABORT_SITES > 0
+    if (all != NULL) {
+      n = sites_merge(all, n, block);
+    }
+#endif
+  }
+
+  pthread_mutex_unlock(&reg->stats_lock);
+
+  // Ticks to nanoseconds
+  uint64_t ticks = stats_now() - reg->stats_ticks;
+  double ns_per_tick = ticks == 0 ? 1. : (double)(stats_ns() - reg->stats_ns) / ticks;
+
+  stats->commit_ns = (uint64_t)(stats->commit_ns * ns_per_tick);
+  stats->wait_ns = (uint64_t)(stats->wait_ns * ns_per_tick);
+
+#if ABORT_SITES > 0
+  if (all != NULL) {
+    qsort(all, n, sizeof(struct AbortSite), site_compare);
+
+    for (size_t i = 0; i < n && i < TM_STATS_SITES; ++i) {
+      stats->sites[i] = (struct tm_abort_site){
+          .segment = all[i].segment, .word = all[i].word, .count = all[i].count};
+    }
+
+    free(all);
+  }
+#endif
+
+  return true;
+}
+
+void stats_print(struct Region *reg) {
+  struct tm_stats stats;
+
+  uint64_t commits = 0;
+
+  stats_sum(reg, &stats, false);
+
+  fprintf(stderr, "tm: %zu thread(s), begins/commits:", stats.threads);
+  for (size_t i = 0; i < tm_modes; ++i) {
+    fprintf(stderr, " %s %lu/%lu", mode_names[i],
+            (unsigned long)stats.begins[i], (unsigned long)stats.commits[i]);
+    commits += stats.commits[i];
+  }
+  fprintf(stderr, "\n");
+
+  fprintf(stderr,
+          "tm: %lu word(s) read, %lu written, %lu addition(s), %lu epoch(s)\n",
+          (unsigned long)stats.reads, (unsigned long)stats.writes,
+          (unsigned long)stats.adds, (unsigned long)stats.epochs);
+
+  fprintf(stderr, "tm: %.0f ns per commit, %.3f ms waiting for epochs\n",
+          commits == 0 ? 0. : (double)stats.commit_ns / commits,
+          stats.wait_ns / 1e6);
+
+  fprintf(stderr, "tm: aborts:");
+  for (size_t i = 0; i < tm_abort_reasons; ++i) {
+    fprintf(stderr, " %s %lu", reason_names[i], (unsigned long)stats.aborts[i]);
+  }
+  fprintf(stderr, "\n");
+
+  fprintf(stderr, "tm: %lu irrevocable transaction(s), %lu promoted\n",
+          (unsigned long)stats.irrevocable, (unsigned long)stats.promoted);
+
+  for (size_t i = 0; i < TM_STATS_SITES && stats.sites[i].count > 0; ++i) {
+    fprintf(stderr, "tm: %lu abort(s) on segment %zu, word %zu\n",
+            (unsigned long)stats.sites[i].count, stats.sites[i].segment,
+            stats.sites[i].word);
+  }
+}
+
+#endif
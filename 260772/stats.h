@@ -0,0 +1,204 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include <tm.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "helper.h"
+#include "macros.h"
+
+// Counters of the transactions of a region (tm_stats). Each thread counts in a
+// block of its own, on cache lines of its own, linked to the region the first
+// time the thread counts something on it. The blocks are only summed on
+// demand, and freed with the region. Only a region created with TM_STATS set
+// counts, any other pays a branch per event. Without USE_STATS, counting
+// compiles to nothing and tm_stats fails.
+
+enum Stat {
+  STAT_BEGINS,                     // + enum Mode
+  STAT_COMMITS = STAT_BEGINS + 3,  // + enum Mode
+  STAT_ABORTS = STAT_COMMITS + 3,  // + enum tm_abort_reason
+  STAT_READS = STAT_ABORTS + tm_abort_reasons,
+  STAT_WRITES,
+  STAT_ADDS,
+  STAT_EPOCHS,
+  STAT_COMMIT_NS,
+  STAT_WAIT_NS,
+  STAT_IRREVOCABLE,
+  STAT_PROMOTED,
+  STATS
+};
+
+_Static_assert(tm_modes == 3 && (int)MODE_BATCHER == (int)tm_mode_batcher &&
+                   (int)MODE_LOCK == (int)tm_mode_lock &&
+                   (int)MODE_OPTIMISTIC == (int)tm_mode_optimistic,
+               "enum Mode must match enum tm_stats_mode");
+
+static inline uint64_t stats_ns(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// Time stamp for the durations: the time stamp counter where there is one, a
+// fraction of the cost of a clock. Durations are converted to nanoseconds when
+// summed, from the ticks and nanoseconds elapsed since the region was created.
+static inline uint64_t stats_now(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return stats_ns();
+#endif
+}
+
+#if USE_STATS
+
+// Word of the region that made the thread abort
+struct AbortSite {
+  uintptr_t segment;
+  size_t word;
+  uint64_t count;
+};
+
+struct ThreadStats {
+  cache_aligned atomic_uint_fast64_t counters[STATS];
+
+#if ABORT_SITES > 0
+  // Words that made the thread abort the most, or rather Space-Saving
+  // estimates of them: a word not in the table takes the place of the least
+  // counted one, with its count plus one. Written when the thread aborts.
+  cache_aligned pthread_mutex_t sites_lock;
+  struct AbortSite sites[ABORT_SITES];
+#endif
+
+  uint64_t commits; // Commits ended, to time one in STATS_SAMPLE
+
+  pthread_t owner;
+  struct ThreadStats *next;
+};
+
+// Block of the calling thread on the region it last counted on
+extern initial_exec _Thread_local struct ThreadStats *stats_cached;
+extern initial_exec _Thread_local uint_fast64_t stats_cached_region;
+
+// Accesses of the running transaction of the thread, added to its block when
+// the transaction leaves (stats_flush)
+extern initial_exec _Thread_local uint64_t stats_reads;  // Words
+extern initial_exec _Thread_local uint64_t stats_writes; // Words
+extern initial_exec _Thread_local uint64_t stats_adds;
+
+void stats_init(struct Region *reg);
+void stats_destroy(struct Region *reg);
+struct ThreadStats *stats_register(struct Region *reg);
+void stats_abort(struct Region *reg, enum tm_abort_reason reason,
+                 void const *address);
+bool stats_sum(struct Region *reg, struct tm_stats *stats, bool thread_only);
+void stats_print(struct Region *reg);
+
+// Block of the calling thread on the region, NULL when out of memory: the
+// event is then not counted
+static inline struct ThreadStats *stats_thread(struct Region *reg) {
+  if (likely(stats_cached_region == reg->stats_id)) {
+    return stats_cached;
+  }
+
+  return stats_register(reg);
+}
+
+// Whether the region counts (TM_STATS)
+static inline bool stats_enabled(struct Region *reg) {
+  return unlikely(reg->options.stats);
+}
+
+// Only the owner of a block writes its counters: no atomic read-modify-write
+static inline void stats_add(struct Region *reg, enum Stat stat, uint64_t n) {
+  if (!stats_enabled(reg)) {
+    return;
+  }
+
+  struct ThreadStats *block = stats_thread(reg);
+
+  if (likely(block != NULL)) {
+    atomic_uint_fast64_t *counter = &block->counters[stat];
+
+    atomic_store_explicit(
+        counter, atomic_load_explicit(counter, memory_order_relaxed) + n,
+        memory_order_relaxed);
+  }
+}
+
+static inline void stats_read(struct Region *reg, uint64_t words) {
+  if (stats_enabled(reg)) {
+    stats_reads += words;
+  }
+}
+static inline void stats_write(struct Region *reg, uint64_t words) {
+  if (stats_enabled(reg)) {
+    stats_writes += words;
+  }
+}
+static inline void stats_addition(struct Region *reg) {
+  if (stats_enabled(reg)) {
+    ++stats_adds;
+  }
+}
+
+static inline void stats_flush(struct Region *reg) {
+  if (!stats_enabled(reg)) {
+    return;
+  }
+
+  stats_add(reg, STAT_READS, stats_reads);
+  stats_add(reg, STAT_WRITES, stats_writes);
+  stats_add(reg, STAT_ADDS, stats_adds);
+
+  stats_reads = 0;
+  stats_writes = 0;
+  stats_adds = 0;
+}
+
+// Whether to time the commit about to start: one in STATS_SAMPLE of the
+// thread, its duration then counted STATS_SAMPLE times
+static inline bool stats_sample(struct Region *reg) {
+  if (!stats_enabled(reg)) {
+    return false;
+  }
+
+  struct ThreadStats *block = stats_thread(reg);
+
+  return likely(block != NULL) && block->commits++ % STATS_SAMPLE == 0;
+}
+
+#else
+
+static inline void stats_init(struct Region *unused(reg)) {}
+static inline void stats_destroy(struct Region *unused(reg)) {}
+static inline void stats_abort(struct Region *unused(reg),
+                               enum tm_abort_reason unused(reason),
+                               void const *unused(address)) {}
+static inline bool stats_sum(struct Region *unused(reg),
+                             struct tm_stats *unused(stats),
+                             bool unused(thread_only)) {
+  return false;
+}
+static inline void stats_print(struct Region *unused(reg)) {}
+static inline void stats_add(struct Region *unused(reg),
+                             enum Stat unused(stat), uint64_t unused(n)) {}
+static inline bool stats_enabled(struct Region *unused(reg)) { return false; }
+static inline void stats_read(struct Region *unused(reg),
+                              uint64_t unused(words)) {}
+static inline void stats_write(struct Region *unused(reg),
+                               uint64_t unused(words)) {}
+static inline void stats_addition(struct Region *unused(reg)) {}
+static inline void stats_flush(struct Region *unused(reg)) {}
+static inline bool stats_sample(struct Region *unused(reg)) { return false; }
+
+#endif
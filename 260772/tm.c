@@ -24,12 +24,21 @@
 #include <stdio.h> // for debug purposes
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 
 // Internal headers
 #include <tm.h>
 
+#include "contention.h"
 #include "helper.h"
 #include "macros.h"
+#include "modes.h"
+#include "numa.h"
+#include "probes.h"
+#include "profile.h"
+#include "segment.h"
+#include "stats.h"
+#include "trace.h"
 
 /** Create (i.e. allocate + init) a new shared memory region, with one first
  *non-free-able allocated segment of the requested size and alignment.
@@ -40,30 +49,59 @@
  * @return Opaque shared memory region handle, 'invalid_shared' on failure
  **/
 shared_t tm_create(size_t size, size_t align) {
-  struct Region *reg = (struct Region *)calloc(1, sizeof(struct Region));
+  struct Options options;
 
-  if (unlikely(!reg)) {
+  options_load(&options);
+
+  // Zeroed, and not touched before being placed
+  struct Region *reg =
+      (struct Region *)mmap(NULL, sizeof(struct Region), PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+  if (unlikely(reg == MAP_FAILED)) {
     printf("Error: Could not allocate memory.\n");
-    free(reg);
     return invalid_shared;
   }
 
-  init_batcher(&reg->batcher);
+  numa_place_home(&options, reg, sizeof(struct Region));
+
+  // Initialize the region fields
+  reg->options = options;
+  reg->n_segments = 0; // the index of next segment to allocate
+  reg->align = align;
+
+  init_list(&reg->free_slots, sizeof(uintptr_t));
+  pthread_mutex_init(&reg->free_slots_lock, NULL);
+
+  // Try to reserve the region and allocate the first segment (at index 0),
+  // its memory and controls are set to 0
+  uintptr_t index;
 
-  // Try to allocate the aligned memory for the first segment
-  if (unlikely(posix_memalign(&(reg->segments_write[0]), align, size) != 0 ||
-               posix_memalign(&(reg->segments_read[0]), align, size) != 0)) {
-    free(reg);
+  if (unlikely(!region_map(reg, size, align))) {
+    destroy_list(&reg->free_slots);
+    pthread_mutex_destroy(&reg->free_slots_lock);
+    munmap(reg, sizeof(struct Region));
     return invalid_shared;
   }
 
-  // Set the segment memory to 0
-  memset(reg->segments_write[0], 0, size);
-  memset(reg->segments_read[0], 0, size);
+  if (unlikely(!seg_alloc(reg, size, 0, &index))) {
+    region_unmap(reg);
+    destroy_list(&reg->free_slots);
+    pthread_mutex_destroy(&reg->free_slots_lock);
+    munmap(reg, sizeof(struct Region));
+    return invalid_shared;
+  }
+
+  init_batcher(&reg->batcher);
 
-  // Initialize the control struct (set everything to 0)
-  reg->controls[0] =
-      (struct Control *)calloc(size / align, sizeof(struct Control));
+  reg->mode = reg->options.mode; // As region_map may have changed it
+  atomic_init(&reg->seq, 0);
+  lock_init(reg);
+  mode_init(reg);
+  cm_init(reg);
+  stats_init(reg);
+  trace_init(reg);
+  profile_init(reg);
 
   init_list(&reg->modified_controls, sizeof(struct Control *));
   init_list(&reg->freed_segments, sizeof(uintptr_t));
@@ -71,13 +109,6 @@ shared_t tm_create(size_t size, size_t align) {
   pthread_mutex_init(&reg->modified_controls_lock, NULL);
   pthread_mutex_init(&reg->freed_segments_lock, NULL);
 
-  // Initialize the region fields
-  reg->n_segments = 1; // the index of next segment to allocate
-  // memset(reg->size, 0, MAX_SEGMENTS * sizeof(size_t));
-  // memset(reg->to_free, 0, MAX_SEGMENTS);
-  reg->size[0] = size;
-  reg->align = align;
-
   return reg;
 }
 
@@ -87,33 +118,32 @@ shared_t tm_create(size_t size, size_t align) {
 void tm_destroy(shared_t shared) {
   struct Region *reg = (struct Region *)shared;
 
-  batcher_destroy(&reg->batcher);
-
-  size_t seg = 1;
-  size_t i = 0;
-
-  while (seg < MAX_SEGMENTS && i < reg->n_segments) {
-    if (reg->controls[seg] != NULL) {
-      free(reg->segments_write[seg]);
-      free(reg->segments_read[seg]);
-      free(reg->controls[seg]);
-      ++i;
-    }
-
-    ++seg;
+  if (reg->options.stats) {
+    stats_print(reg);
   }
+  if (reg->options.profile > 0) {
+    profile_print(reg);
+  }
+
+  batcher_destroy(&reg->batcher);
+  lock_destroy(reg);
+  mode_destroy(reg);
+  cm_destroy(reg);
+  stats_destroy(reg);
+  trace_destroy(reg);
+  profile_destroy(reg);
 
-  free(reg->segments_write[0]);
-  free(reg->segments_read[0]);
-  free(reg->controls[0]);
+  region_unmap(reg);
 
   destroy_list(&reg->freed_segments);
   destroy_list(&reg->modified_controls);
+  destroy_list(&reg->free_slots);
 
   pthread_mutex_destroy(&reg->modified_controls_lock);
   pthread_mutex_destroy(&reg->freed_segments_lock);
+  pthread_mutex_destroy(&reg->free_slots_lock);
 
-  free(reg);
+  munmap(reg, sizeof(struct Region));
 }
 
 /** [thread-safe] Return the start address of the first allocated segment in the
@@ -121,7 +151,9 @@ void tm_destroy(shared_t shared) {
  * @param shared Shared memory region to query
  * @return Start address of the first allocated segment
  **/
-void *tm_start(shared_t unused(shared)) { return (void *)((uintptr_t)1 << 48); }
+void *tm_start(shared_t shared) {
+  return seg_address((struct Region *)shared, 0);
+}
 
 /** [thread-safe] Return the size (in bytes) of the first allocated segment of
  *the shared memory region.
@@ -137,16 +169,24 @@ size_t tm_size(shared_t shared) { return ((struct Region *)shared)->size[0]; }
  **/
 size_t tm_align(shared_t shared) { return ((struct Region *)shared)->align; }
 
-/** [thread-safe] Begin a new transaction on the given shared memory region.
- * @param shared Shared memory region to start a transaction on
- * @param is_ro  Whether the transaction is read-only
- * @return Opaque transaction ID, 'invalid_tx' on failure
- **/
-tx_t tm_begin(shared_t shared, bool is_ro) {
-  struct Region *reg = (struct Region *)shared;
+// Batcher (MODE_BATCHER) transactions, the default mode. A read-only one never
+// aborts, so it is never made irrevocable.
+static tx_t batcher_begin(struct Region *reg, bool is_ro, bool irrevocable) {
+  // Only a running epoch is waited for
+  uint64_t start =
+      stats_enabled(reg) && atomic_load_explicit(&reg->batcher.remaining,
+                                                 memory_order_relaxed) > 0
+          ? stats_now()
+          : 0;
+
+  trace(reg, TRACE_WAIT_START, MODE_BATCHER);
 
   if (is_ro) {
     enter(&reg->batcher);
+    trace(reg, TRACE_WAIT_END, MODE_BATCHER);
+    if (start != 0) {
+      stats_add(reg, STAT_WAIT_NS, stats_now() - start);
+    }
     return read_only_tx;
   }
 
@@ -159,29 +199,63 @@ tx_t tm_begin(shared_t shared, bool is_ro) {
   }
 
   // Unique transaction defined by id and shared
-  tr->id = atomic_fetch_add(&reg->batcher.tx_count, 1);
+  tr->id = tx_id();
   // tr->is_ro = is_ro;
   tr->is_aborted = 0;
   // tr->shared = shared;
   init_list(&tr->alloced_segments, sizeof(uintptr_t));
   init_list(&tr->freed_segments, sizeof(uintptr_t));
-  init_list(&tr->accessed_words, sizeof(struct Control *));
 
-  enter(&reg->batcher);
+  // Irrevocable: alone in its epoch whatever USE_SOLO, as a solo transaction
+  // only aborts when out of memory
+  if (irrevocable) {
+    enter_exclusive(&reg->batcher);
+    tr->irrevocable = true;
+    tr->solo = true;
+  } else {
+    tr->solo = enter(&reg->batcher) && USE_SOLO;
+  }
+
+  trace(reg, TRACE_WAIT_END, MODE_BATCHER);
+
+  if (start != 0) {
+    stats_add(reg, STAT_WAIT_NS, stats_now() - start);
+  }
+
+  if (tr->solo) {
+    init_list(&tr->undo, sizeof(struct Undo));
+  } else {
+    init_list(&tr->accessed_words, sizeof(struct Control *));
+    init_list(&tr->adds, sizeof(struct Add));
+  }
 
   return (uintptr_t)tr;
 }
 
-/** [thread-safe] End the given transaction.
- * @param shared Shared memory region associated with the transaction
- * @param tx     Transaction to end
- * @return Whether the whole transaction committed
- **/
-bool tm_end(shared_t shared, tx_t tx) {
-  struct Region *reg = (struct Region *)shared;
+// Reset the control of a word accessed by an aborted transaction, unless a
+// word it only read was since written or added to by other transactions,
+// which then own the control until the end of the epoch
+static void release_control(struct Transaction *tr, struct Control *control) {
+  acs value = atomic_load(&control->access_type_id);
 
+  do {
+    if (ACS_TYPE(value) && (ACS_WA(value) || ACS_ID(value) != tr->id)) {
+      return;
+    }
+  } while (!atomic_compare_exchange_weak(&control->access_type_id, &value,
+                                         ACS_NULL));
+
+#if !USE_VMEM
+  control->saved = 0;
+#endif
+  control->tx_read = 0;
+  control->accessed_write = 0;
+  control->accessed_epoch = 0;
+}
+
+static bool batcher_end(struct Region *reg, tx_t tx) {
   if (tx == read_only_tx) {
-    leave(&reg->batcher, commit, shared);
+    leave(&reg->batcher, commit, reg);
 
     return true;
   }
@@ -192,25 +266,30 @@ bool tm_end(shared_t shared, tx_t tx) {
   bool correct = true;
 
   if (unlikely(tr->is_aborted)) {
+    if (tr->solo) {
+      undo_solo(tr);
+    }
+
     // Must undo writes and reads
     for (size_t i = 0; i < tr->accessed_words.n; ++i) {
       control = get_list(&tr->accessed_words, i, struct Control *);
-      control->saved = 0;
-      control->tx_read = 0;
-      control->accessed_write = 0;
-      control->accessed_epoch = 0;
-      control->access_type_id = ACS_NULL;
+      release_control(tr, control);
     }
 
     // Must free allocated segments
     for (size_t i = 0; i < tr->alloced_segments.n; ++i) {
       index = get_list(&tr->alloced_segments, i, uintptr_t);
-      atomic_fetch_sub(&reg->n_segments, 1);
-      seg_free(shared, index);
+      seg_free(reg, index);
     }
 
     correct = false;
   } else {
+    // Join the sums, before leaving the epoch that commits them
+    for (size_t i = 0; i < tr->adds.n; ++i) {
+      struct Add *add = &get_list(&tr->adds, i, struct Add);
+      add_int_atomic(add->sum, add->delta, add->width);
+    }
+
     if (tr->freed_segments.n > 0) {
       pthread_mutex_lock(&reg->freed_segments_lock);
       for (size_t i = 0; i < tr->freed_segments.n; ++i) {
@@ -232,17 +311,269 @@ bool tm_end(shared_t shared, tx_t tx) {
     // Mark to  free segments
   }
 
-  leave(&reg->batcher, commit, shared);
+  if (tr->irrevocable) {
+    leave_exclusive(&reg->batcher, commit, reg);
+  } else {
+    leave(&reg->batcher, commit, reg);
+  }
 
   // Clean up tx
   destroy_list(&tr->alloced_segments);
   destroy_list(&tr->freed_segments);
   destroy_list(&tr->accessed_words);
+  destroy_list(&tr->adds);
+  destroy_list(&tr->undo);
+  free(tr->undo_values);
   free(tr);
 
   return correct;
 }
 
+// Whether the address is in a segment allocated by the transaction itself,
+// which no other transaction can reach before it commits. Such words are
+// read and written in their read copy, without controls: nothing to copy at
+// commit, and an abort frees the segment anyway.
+static inline bool is_private(struct Region *reg, struct Transaction *tr,
+                              void const *address) {
+  // Ids only wrap around after TX_ID_MASK of them: the owner of a published
+  // or freed segment matches no running transaction
+  return reg->owner[seg_index(reg, address)] == tr->id;
+}
+
+static bool batcher_read(struct Region *reg, tx_t tx, void const *source,
+                         size_t size, void *target) {
+  struct Transaction *tr = (struct Transaction *)tx;
+  acs acs_read = ACS_NULL;
+
+  if (tx != read_only_tx) {
+    if (tr->solo || is_private(reg, tr, source)) {
+      read_solo(reg, target, source, size);
+      return true;
+    }
+
+    acs_read = ACS_CREATE(tr->id, 0, 1, 1); // supposing we've written
+  }
+
+  for (size_t i = 0; i < size / reg->align; ++i) {
+    bool result = read_word(reg, tx, ((char *)target + i * reg->align),
+                            ((char const *)source + i * reg->align), acs_read);
+    if (!result) {
+      ((struct Transaction *)tx)->is_aborted = 1;
+      batcher_end(reg, tx);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static bool batcher_write(struct Region *reg, tx_t tx, void const *source,
+                          size_t size, void *target) {
+  struct Transaction *tr = (struct Transaction *)tx;
+
+  if (is_private(reg, tr, target)) {
+    memcpy(word_read_copy(reg, target), source, size);
+    return true;
+  }
+
+  if (tr->solo) {
+    if (unlikely(!write_solo(reg, tr, source, target, size))) {
+      tr->is_aborted = 1;
+      batcher_end(reg, tx);
+      return false;
+    }
+
+    return true;
+  }
+
+  acs acs_write = ACS_CREATE(tr->id, ACS_CAN, ACS_WRITE, ACS_ACCESSED);
+
+  for (size_t i = 0; i < size / reg->align; ++i) {
+    bool result = write_word(reg, tx, ((char const *)source + i * reg->align),
+                             ((char *)target + i * reg->align), acs_write);
+    if (!result) {
+      ((struct Transaction *)tx)->is_aborted = 1;
+      batcher_end(reg, tx);
+
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static bool batcher_add(struct Region *reg, tx_t tx, void *target,
+                        int64_t delta, size_t width) {
+  struct Transaction *tr = (struct Transaction *)tx;
+
+  if (is_private(reg, tr, target)) {
+    add_int(word_read_copy(reg, target), delta, width);
+    return true;
+  }
+
+  if (tr->solo) {
+    uint64_t word;
+
+    read_solo(reg, &word, target, width);
+    add_int(&word, delta, width);
+
+    if (unlikely(!write_solo(reg, tr, &word, target, width))) {
+      tr->is_aborted = 1;
+      batcher_end(reg, tx);
+      return false;
+    }
+
+    return true;
+  }
+
+  acs acs_write = ACS_CREATE(tr->id, ACS_CAN, ACS_WRITE, ACS_ACCESSED);
+
+  if (!add_word(reg, tr, target, delta, width, acs_write)) {
+    tr->is_aborted = 1;
+    batcher_end(reg, tx);
+    return false;
+  }
+
+  return true;
+}
+
+static alloc_t batcher_alloc(struct Region *reg, tx_t tx, size_t size,
+                             void **target) {
+  struct Transaction *tr = (struct Transaction *)tx;
+  // printf("Tx: %ld Alloc\n", tr->id);
+
+  uintptr_t index;
+
+  // Reserve the slot(s) of the segment, its memory and controls are set to 0
+  if (unlikely(!seg_alloc(reg, size, tr->id, &index))) {
+    return nomem_alloc;
+  }
+
+  *target = seg_address(reg, index);
+
+  insert_list(&tr->alloced_segments, index, uintptr_t);
+
+  return success_alloc;
+}
+
+static bool batcher_free(struct Region *reg, tx_t tx, void *target) {
+  struct Transaction *tr = (struct Transaction *)tx;
+  uintptr_t index = seg_index(reg, target);
+
+  insert_list(&tr->freed_segments, index, uintptr_t);
+
+  return true;
+}
+
+// Every transaction leaves once, when it commits or aborts
+static void tx_leave(struct Region *reg, tx_t tx, bool committed) {
+  if (committed) {
+    probe3(commit, reg, tx, (int)reg->mode);
+  } else {
+    probe3(abort, reg, tx, (int)reg->mode);
+  }
+
+  mode_leave(reg, committed);
+  cm_end(reg, committed);
+  stats_flush(reg);
+  trace(reg, committed ? TRACE_COMMIT : TRACE_ABORT, reg->mode);
+}
+
+// Begin a transaction, irrevocably if asked to or if the previous attempts of
+// the calling thread aborted too many times in a row (cm_promote)
+static tx_t tx_begin(struct Region *reg, bool is_ro, bool irrevocable) {
+  tx_t tx;
+
+  probe3(begin, reg, (int)is_ro, (int)irrevocable);
+
+  if (!irrevocable && unlikely(cm_promote(reg))) {
+    irrevocable = true;
+    stats_add(reg, STAT_PROMOTED, 1);
+  }
+  if (irrevocable) {
+    stats_add(reg, STAT_IRREVOCABLE, 1);
+  }
+
+  cm_begin(reg);
+
+  enum Mode mode = mode_enter(reg);
+
+  stats_add(reg, STAT_BEGINS + mode, 1);
+  trace(reg, TRACE_BEGIN, mode);
+
+  // A read-write transaction of MODE_LOCK is irrevocable anyway
+  switch (mode) {
+  case MODE_LOCK:
+    tx = lock_begin(reg, is_ro);
+    break;
+  case MODE_OPTIMISTIC:
+    tx = opt_begin(reg, is_ro, irrevocable);
+    break;
+  default:
+    tx = batcher_begin(reg, is_ro, irrevocable);
+  }
+
+  if (unlikely(tx == invalid_tx)) {
+    tx_leave(reg, tx, false);
+  }
+
+  return tx;
+}
+
+/** [thread-safe] Begin a new transaction on the given shared memory region.
+ * @param shared Shared memory region to start a transaction on
+ * @param is_ro  Whether the transaction is read-only
+ * @return Opaque transaction ID, 'invalid_tx' on failure
+ **/
+tx_t tm_begin(shared_t shared, bool is_ro) {
+  return tx_begin((struct Region *)shared, is_ro, false);
+}
+
+/** [thread-safe] Begin a new irrevocable (read-write) transaction on the given
+ *shared memory region: it waits for exclusive access, i.e. the end of the
+ *current epoch, then runs alone and does not abort (unless out of memory).
+ * @param shared Shared memory region to start a transaction on
+ * @return Opaque transaction ID, 'invalid_tx' on failure
+ **/
+tx_t tm_begin_irrevocable(shared_t shared) {
+  return tx_begin((struct Region *)shared, false, true);
+}
+
+/** [thread-safe] End the given transaction.
+ * @param shared Shared memory region associated with the transaction
+ * @param tx     Transaction to end
+ * @return Whether the whole transaction committed
+ **/
+bool tm_end(shared_t shared, tx_t tx) {
+  struct Region *reg = (struct Region *)shared;
+  enum Mode mode = reg->mode;
+  uint64_t start = stats_sample(reg) ? stats_now() : 0;
+  bool committed;
+
+  switch (mode) {
+  case MODE_LOCK:
+    committed = lock_end(reg, tx);
+    break;
+  case MODE_OPTIMISTIC:
+    committed = opt_end(reg, tx);
+    break;
+  default:
+    committed = batcher_end(reg, tx);
+  }
+
+  if (committed) {
+    stats_add(reg, STAT_COMMITS + mode, 1);
+
+    if (start != 0) {
+      stats_add(reg, STAT_COMMIT_NS, (stats_now() - start) * STATS_SAMPLE);
+    }
+  }
+
+  tx_leave(reg, tx, committed);
+
+  return committed;
+}
+
 /** [thread-safe] Read operation in the given transaction, source in the shared
  *region and target in a private region.
  * @param shared Shared memory region associated with the transaction
@@ -256,26 +587,27 @@ bool tm_end(shared_t shared, tx_t tx) {
 bool tm_read(shared_t shared, tx_t tx, void const *source, size_t size,
              void *target) {
   struct Region *reg = (struct Region *)shared;
-  struct Transaction *tr = (struct Transaction *)tx;
-  size_t word_index = WORD_INDEX(source);
-  size_t segment_index = SEGMENT_INDEX(source);
-  acs acs_read = ACS_NULL;
-
-  if (tx != read_only_tx) {
-    acs_read = ACS_CREATE(tr->id, 0, 1, 1); // supposing we've written
+  bool result;
+
+  cm_access();
+  stats_read(reg, size / reg->align);
+
+  switch (reg->mode) {
+  case MODE_LOCK:
+    return lock_read(reg, tx, source, size, target);
+  case MODE_OPTIMISTIC:
+    result = opt_read(reg, tx, source, size, target);
+    break;
+  default:
+    result = batcher_read(reg, tx, source, size, target);
   }
 
-  for (size_t i = 0; i < size / reg->align; ++i) {
-    bool result = read_word(shared, tx, ((char *)target + i * reg->align),
-                            segment_index, word_index + i, acs_read);
-    if (!result) {
-      ((struct Transaction *)tx)->is_aborted = 1;
-      tm_end(shared, tx);
-      return false;
-    }
+  // The transaction already ended
+  if (!result) {
+    tx_leave(reg, tx, false);
   }
 
-  return true;
+  return result;
 }
 
 /** [thread-safe] Write operation in the given transaction, source in a private
@@ -291,23 +623,27 @@ bool tm_read(shared_t shared, tx_t tx, void const *source, size_t size,
 bool tm_write(shared_t shared, tx_t tx, void const *source, size_t size,
               void *target) {
   struct Region *reg = (struct Region *)shared;
-  struct Transaction *tr = (struct Transaction *)tx;
-  size_t word_index = WORD_INDEX(target);
-  size_t segment_index = SEGMENT_INDEX(target);
-  acs acs_write = ACS_CREATE(tr->id, ACS_CAN, ACS_WRITE, ACS_ACCESSED);
-
-  for (size_t i = 0; i < size / reg->align; ++i) {
-    bool result = write_word(shared, tx, ((char *)source + i * reg->align),
-                             segment_index, word_index + i, acs_write);
-    if (!result) {
-      ((struct Transaction *)tx)->is_aborted = 1;
-      tm_end(shared, tx);
+  bool result;
+
+  cm_access();
+  stats_write(reg, size / reg->align);
+
+  switch (reg->mode) {
+  case MODE_LOCK:
+    return lock_write(reg, tx, source, size, target);
+  case MODE_OPTIMISTIC:
+    result = opt_write(reg, tx, source, size, target);
+    break;
+  default:
+    result = batcher_write(reg, tx, source, size, target);
+  }
 
-      return false;
-    }
+  // The transaction already ended
+  if (!result) {
+    tx_leave(reg, tx, false);
   }
 
-  return true;
+  return result;
 }
 
 /** [thread-safe] Memory allocation in the given transaction.
@@ -322,43 +658,23 @@ bool tm_write(shared_t shared, tx_t tx, void const *source, size_t size,
  **/
 alloc_t tm_alloc(shared_t shared, tx_t tx, size_t size, void **target) {
   struct Region *reg = (struct Region *)shared;
-  struct Transaction *tr = (struct Transaction *)tx;
-  // printf("Tx: %ld Alloc\n", tr->id);
-
-  // pthread_mutex_lock(&reg->batcher.alloc_lock);
-  uintptr_t index = next_free(reg);
-  // ++reg->n_segments;
-  // pthread_mutex_unlock(&reg->batcher.alloc_lock);
-
-  // if (unlikely(tr->is_aborted))
-  // {
-  //   atomic_fetch_sub(&reg->n_segments, 1);
-  //   return abort_alloc;
-  // }
-
-  if (unlikely(posix_memalign((void **)&(reg->segments_write[index]),
-                              reg->align, size) != 0 ||
-               posix_memalign((void **)&(reg->segments_read[index]), reg->align,
-                              size) != 0)) {
-    atomic_fetch_sub(&reg->n_segments, 1);
-    return nomem_alloc;
+  alloc_t result;
+
+  switch (reg->mode) {
+  case MODE_LOCK:
+    result = lock_alloc(reg, tx, size, target);
+    break;
+  case MODE_OPTIMISTIC:
+    result = opt_alloc(reg, tx, size, target);
+    break;
+  default:
+    result = batcher_alloc(reg, tx, size, target);
   }
 
-  memset(reg->segments_write[index], 0, size);
-  memset(reg->segments_read[index], 0, size);
-
-  // Allocate control structre
-  reg->controls[index] =
-      (struct Control *)calloc(size / reg->align, sizeof(struct Control));
-
-  // We add one because we start a 1, the first segment was allocated at
-  // creation of the shared memory.
-  *target = (void *)((index + 1) << 48);
-  reg->size[index] = size;
+  probe5(alloc, reg, tx, size, (int)result,
+         result == success_alloc ? *target : NULL);
 
-  insert_list(&tr->alloced_segments, index, uintptr_t);
-
-  return success_alloc;
+  return result;
 }
 
 /** [thread-safe] Memory freeing in the given transaction.
@@ -368,11 +684,117 @@ alloc_t tm_alloc(shared_t shared, tx_t tx, size_t size, void **target) {
  *to deallocate
  * @return Whether the whole transaction can continue
  **/
-bool tm_free(shared_t unused(shared), tx_t tx, void *target) {
-  struct Transaction *tr = (struct Transaction *)tx;
-  uintptr_t index = SEGMENT_INDEX(target);
+bool tm_free(shared_t shared, tx_t tx, void *target) {
+  struct Region *reg = (struct Region *)shared;
+  bool result;
+
+  switch (reg->mode) {
+  case MODE_LOCK:
+    result = lock_free(reg, tx, target);
+    break;
+  case MODE_OPTIMISTIC:
+    result = opt_free(reg, tx, target);
+    break;
+  default:
+    result = batcher_free(reg, tx, target);
+  }
 
-  insert_list(&tr->freed_segments, index, uintptr_t);
+  probe4(free, reg, tx, target, (int)result);
 
-  return true;
+  return result;
+}
+
+/** [thread-safe] Commutative addition in the given transaction, to a shared
+ *integer that the transaction does not otherwise access.
+ * @param shared Shared memory region associated with the transaction
+ * @param tx     Transaction to use
+ * @param target Shared word whose first width bytes hold the integer
+ * @param delta  Value to add, wrapping around
+ * @param width  Size of the integer (in bytes): 1, 2, 4 or 8, at most the
+ *alignment
+ * @return Whether the whole transaction can continue (any other width ends
+ *it, rolled back unless it runs in place: lock mode or irrevocable)
+ **/
+bool tm_add(shared_t shared, tx_t tx, void *target, int64_t delta,
+            size_t width) {
+  struct Region *reg = (struct Region *)shared;
+  bool result;
+
+  cm_access();
+  stats_addition(reg);
+
+  if (unlikely((width != 1 && width != 2 && width != 4 && width != 8) ||
+               width > reg->align)) {
+    switch (reg->mode) {
+    case MODE_LOCK:
+      lock_end(reg, tx);
+      break;
+    case MODE_OPTIMISTIC:
+      opt_abort(reg, tx);
+      break;
+    default:
+      ((struct Transaction *)tx)->is_aborted = 1;
+      batcher_end(reg, tx);
+    }
+
+    tx_leave(reg, tx, false);
+    return false;
+  }
+
+  switch (reg->mode) {
+  case MODE_LOCK:
+    return lock_add(reg, tx, target, delta, width);
+  case MODE_OPTIMISTIC:
+    result = opt_add(reg, tx, target, delta, width);
+    break;
+  default:
+    result = batcher_add(reg, tx, target, delta, width);
+  }
+
+  // The transaction already ended
+  if (!result) {
+    tx_leave(reg, tx, false);
+  }
+
+  return result;
+}
+
+/** [thread-safe] Contention management hook, for the caller of a transaction
+ *that just aborted, before it retries it.
+ * @param shared Shared memory region associated with the aborted transaction
+ * @return Time to wait (in nanoseconds) before the retry, 0 to retry at once
+ **/
+uint64_t tm_should_wait(shared_t shared) {
+  return cm_wait((struct Region *)shared);
+}
+
+/** [thread-safe] Counters of the transactions run on the given shared memory
+ *region, summed over the threads that ran them.
+ * @param shared Shared memory region to query
+ * @param stats  Counters to fill
+ * @return Whether counters are kept
+ **/
+bool tm_stats(shared_t shared, struct tm_stats *stats) {
+  return stats_sum((struct Region *)shared, stats, false);
+}
+
+/** [thread-safe] Counters of the transactions run by the calling thread on the
+ *given shared memory region.
+ * @param shared Shared memory region to query
+ * @param stats  Counters to fill
+ * @return Whether counters are kept
+ **/
+bool tm_stats_thread(shared_t shared, struct tm_stats *stats) {
+  return stats_sum((struct Region *)shared, stats, true);
+}
+
+/** [thread-safe] Most contended words of the given shared memory region, most
+ *contended first.
+ * @param shared Shared memory region to query
+ * @param words  Array to fill
+ * @param n      Size of the array
+ * @return Words filled, 0 if the region is not profiled
+ **/
+size_t tm_profile(shared_t shared, struct tm_hot_word *words, size_t n) {
+  return profile_top((struct Region *)shared, words, n);
 }
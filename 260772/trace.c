@@ -0,0 +1,146 @@
+#define _GNU_SOURCE
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "macros.h"
+#include "trace.h"
+
+#if USE_TRACE
+
+// Regions ever traced, so that a thread tells a region from a previous one
+// created at the same address
+static atomic_uint_fast64_t trace_regions = 0;
+
+initial_exec _Thread_local struct TraceRing *trace_cached = NULL;
+initial_exec _Thread_local uint_fast64_t trace_cached_region = 0;
+
+void trace_init(struct Region *reg) {
+  reg->trace_path = NULL;
+  reg->traces = NULL;
+
+  if (reg->options.trace == NULL) {
+    return;
+  }
+
+  reg->trace_path = strdup(reg->options.trace);
+
+  if (reg->trace_path == NULL) {
+    fprintf(stderr, "Warning: could not trace to '%s'\n", reg->options.trace);
+    return;
+  }
+
+  pthread_mutex_init(&reg->trace_lock, NULL);
+  reg->trace_id = atomic_fetch_add(&trace_regions, 1) + 1;
+  reg->trace_ticks = stats_now();
+  reg->trace_ns = stats_ns();
+}
+
+// Ring of the calling thread on the region, linked on first use. Zeroed, and
+// only backed as the events are recorded: the first event of a thread does
+// not pay for the whole ring.
+struct TraceRing *trace_register(struct Region *reg) {
+  pthread_t self = pthread_self();
+  struct TraceRing *ring;
+  uint16_t thread = 0;
+
+  pthread_mutex_lock(&reg->trace_lock);
+
+  for (ring = reg->traces; ring != NULL; ring = ring->next) {
+    if (pthread_equal(ring->owner, self)) {
+      break;
+    }
+    ++thread;
+  }
+
+  if (ring == NULL) {
+    ring = (struct TraceRing *)mmap(NULL, sizeof(struct TraceRing),
+                                    PROT_READ | PROT_WRITE,
+                                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (ring != MAP_FAILED) {
+      ring->thread = thread;
+      ring->owner = self;
+      ring->next = reg->traces;
+      reg->traces = ring;
+    } else {
+      ring = NULL;
+    }
+  }
+
+  pthread_mutex_unlock(&reg->trace_lock);
+
+  if (ring != NULL) {
+    trace_cached = ring;
+    trace_cached_region = reg->trace_id;
+  }
+
+  return ring;
+}
+
+// Write the events kept by the rings, oldest first per thread
+static void trace_write(struct Region *reg) {
+  FILE *file = fopen(reg->trace_path, "wb");
+
+  if (file == NULL) {
+    fprintf(stderr, "Warning: could not open TM_TRACE '%s'\n",
+            reg->trace_path);
+    return;
+  }
+
+  uint64_t ticks = stats_now() - reg->trace_ticks;
+  struct TraceHeader header = {
+      .magic = TRACE_MAGIC,
+      .ns_per_tick =
+          ticks == 0 ? 1. : (double)(stats_ns() - reg->trace_ns) / ticks,
+      .start = reg->trace_ticks,
+      .events = 0,
+  };
+
+  for (struct TraceRing *ring = reg->traces; ring != NULL; ring = ring->next) {
+    uint64_t head = atomic_load(&ring->head);
+
+    header.events += head < TRACE_EVENTS ? head : TRACE_EVENTS;
+  }
+
+  bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+
+  for (struct TraceRing *ring = reg->traces; written && ring != NULL;
+       ring = ring->next) {
+    uint64_t head = atomic_load(&ring->head);
+    uint64_t first = head < TRACE_EVENTS ? 0 : head - TRACE_EVENTS;
+
+    for (uint64_t i = first; written && i < head; ++i) {
+      written = fwrite(&ring->events[i & (TRACE_EVENTS - 1)],
+                       sizeof(struct TraceEvent), 1, file) == 1;
+    }
+  }
+
+  if (fclose(file) != 0 || !written) {
+    fprintf(stderr, "Warning: could not write TM_TRACE '%s'\n",
+            reg->trace_path);
+  }
+}
+
+void trace_destroy(struct Region *reg) {
+  struct TraceRing *next;
+
+  if (reg->trace_path == NULL) {
+    return;
+  }
+
+  trace_write(reg);
+
+  for (struct TraceRing *ring = reg->traces; ring != NULL; ring = next) {
+    next = ring->next;
+    munmap(ring, sizeof(struct TraceRing));
+  }
+
+  free(reg->trace_path);
+  pthread_mutex_destroy(&reg->trace_lock);
+}
+
+#endif
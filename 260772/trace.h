@@ -0,0 +1,117 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "helper.h"
+#include "macros.h"
+#include "stats.h"
+
+// Timeline of the transactions of a region, for a run with TM_TRACE set to the
+// file to write it to. Each thread records its events in a ring of its own,
+// linked to the region the first time the thread records something on it: only
+// its owner writes a ring, which keeps the last TRACE_EVENTS events. The rings
+// are written to the file when the region is destroyed, and trace2json.py
+// turns the file into a Chrome trace (chrome://tracing, Perfetto). Without
+// USE_TRACE, recording compiles to nothing.
+//
+// File: the header (struct TraceHeader), then the events (struct TraceEvent)
+// of each thread in order.
+
+enum TraceType {
+  TRACE_BEGIN,       // Transaction begun (mode: enum Mode)
+  TRACE_COMMIT,      // Transaction committed
+  TRACE_ABORT,       // Transaction aborted
+  TRACE_WAIT_START,  // Waiting to enter an epoch
+  TRACE_WAIT_END,    // Entered the epoch
+  TRACE_EPOCH_START, // Last to leave the epoch, commit() started
+  TRACE_EPOCH_END,   // commit() ended
+};
+
+struct TraceEvent {
+  uint64_t ticks;  // Time stamp (stats_now)
+  uint64_t tx;     // Transaction of the thread, counted from 1
+  uint32_t epoch;  // Batcher epoch (truncated)
+  uint16_t thread; // Ring, counted from 0 in order of first event
+  uint8_t type;    // enum TraceType
+  uint8_t mode;    // enum Mode of the transaction
+};
+
+_Static_assert(sizeof(struct TraceEvent) == 24, "struct TraceEvent is packed");
+
+#define TRACE_MAGIC "TMTRACE1"
+
+struct TraceHeader {
+  char magic[8];      // TRACE_MAGIC
+  double ns_per_tick; // Ticks to nanoseconds
+  uint64_t start;     // Time stamp of the creation of the region
+  uint64_t events;    // Events that follow
+};
+
+#if USE_TRACE
+
+struct TraceRing {
+  struct TraceEvent events[TRACE_EVENTS];
+  atomic_uint_fast64_t head; // Events ever recorded
+  uint64_t tx;               // Transactions begun
+  uint8_t mode;              // Mode of the current transaction
+  uint16_t thread;
+  pthread_t owner;
+  struct TraceRing *next;
+};
+
+_Static_assert((TRACE_EVENTS & (TRACE_EVENTS - 1)) == 0,
+               "TRACE_EVENTS must be a power of 2");
+
+// Ring of the calling thread on the region it last recorded on
+extern initial_exec _Thread_local struct TraceRing *trace_cached;
+extern initial_exec _Thread_local uint_fast64_t trace_cached_region;
+
+void trace_init(struct Region *reg);
+void trace_destroy(struct Region *reg);
+struct TraceRing *trace_register(struct Region *reg);
+
+// Record an event of the calling thread, if the region is traced. A begin
+// starts the next transaction of the thread.
+static inline void trace(struct Region *reg, enum TraceType type, int mode) {
+  if (likely(reg->trace_path == NULL)) {
+    return;
+  }
+
+  struct TraceRing *ring = trace_cached_region == reg->trace_id
+                               ? trace_cached
+                               : trace_register(reg);
+
+  if (unlikely(ring == NULL)) {
+    return;
+  }
+
+  if (type == TRACE_BEGIN) {
+    ++ring->tx;
+    ring->mode = (uint8_t)mode;
+  }
+
+  uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+
+  ring->events[head & (TRACE_EVENTS - 1)] = (struct TraceEvent){
+      .ticks = stats_now(),
+      .tx = ring->tx,
+      .epoch = (uint32_t)atomic_load_explicit(&reg->batcher.epoch,
+                                              memory_order_relaxed),
+      .thread = ring->thread,
+      .type = (uint8_t)type,
+      .mode = ring->mode,
+  };
+
+  atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+#else
+
+static inline void trace_init(struct Region *unused(reg)) {}
+static inline void trace_destroy(struct Region *unused(reg)) {}
+static inline void trace(struct Region *unused(reg),
+                         enum TraceType unused(type), int unused(mode)) {}
+
+#endif
@@ -0,0 +1,91 @@
+# coding: utf-8
+###
+ # @file   trace2json.py
+ #
+ # @section DESCRIPTION
+ #
+ # Convert the timeline written by a region traced with TM_TRACE (see trace.h)
+ # to the Chrome trace event format, for chrome://tracing or Perfetto:
+ #   python3 trace2json.py <trace file> [<json file>]
+ # Each thread is a track of transactions (named by outcome), waits to enter an
+ # epoch, and runs of commit() at the end of an epoch.
+###
+
+if __name__ != "__main__":
+  raise RuntimeError("Script " + repr(__file__) + " is to be used as the main module only")
+
+import argparse
+import json
+import struct
+import sys
+
+# ---------------------------------------------------------------------------- #
+# File format (trace.h)
+
+HEADER = struct.Struct("=8sdQQ") # magic, ns per tick, start, events
+EVENT  = struct.Struct("=QQIHBB") # ticks, tx, epoch, thread, type, mode
+MAGIC  = b"TMTRACE1"
+
+BEGIN, COMMIT, ABORT, WAIT_START, WAIT_END, EPOCH_START, EPOCH_END = range(7)
+MODES = ("batcher", "lock", "optimistic")
+
+# ---------------------------------------------------------------------------- #
+# Conversion
+
+def convert(data):
+  """ Chrome trace events of the given trace file content.
+  Args:
+    data Content of the trace file
+  Returns:
+    List of trace events
+  """
+  magic, ns_per_tick, start, count = HEADER.unpack_from(data)
+  if magic != MAGIC:
+    raise RuntimeError("Not a trace file (bad magic " + repr(magic) + ")")
+  if len(data) < HEADER.size + count * EVENT.size:
+    raise RuntimeError("Truncated trace file")
+  def us(ticks):
+    return (ticks - start) * ns_per_tick / 1000.
+  events = []
+  opened = {} # (thread, kind) -> opening event
+  def span(name, thread, first, ticks, args):
+    events.append({"name": name, "ph": "X", "pid": 1, "tid": thread, "ts": us(first), "dur": us(ticks) - us(first), "args": args})
+  for i in range(count):
+    ticks, tx, epoch, thread, kind, mode = EVENT.unpack_from(data, HEADER.size + i * EVENT.size)
+    # The oldest events of a thread may have been overwritten: an end without
+    # its start is skipped
+    if kind in (BEGIN, WAIT_START, EPOCH_START):
+      opened[thread, kind] = (ticks, tx, epoch)
+    elif kind in (COMMIT, ABORT):
+      begin = opened.pop((thread, BEGIN), None)
+      if begin is not None and begin[1] == tx:
+        span("commit" if kind == COMMIT else "abort", thread, begin[0], ticks, {"tx": tx, "mode": MODES[mode] if mode < len(MODES) else mode, "epoch": begin[2]})
+    elif kind == WAIT_END:
+      wait = opened.pop((thread, WAIT_START), None)
+      if wait is not None:
+        span("wait", thread, wait[0], ticks, {"tx": tx, "epoch": epoch})
+    elif kind == EPOCH_END:
+      epoch_start = opened.pop((thread, EPOCH_START), None)
+      if epoch_start is not None:
+        span("epoch commit", thread, epoch_start[0], ticks, {"epoch": epoch_start[2]})
+  for thread in sorted({event["tid"] for event in events}):
+    events.append({"name": "thread_name", "ph": "M", "pid": 1, "tid": thread, "args": {"name": "thread " + str(thread)}})
+  return events
+
+# ---------------------------------------------------------------------------- #
+# Entry point
+
+parser = argparse.ArgumentParser(description="Convert a TM_TRACE timeline to Chrome trace JSON")
+parser.add_argument("trace", type=str, help="Trace file written at tm_destroy")
+parser.add_argument("json", type=str, nargs="?", default=None, help="Output file (standard output if omitted)")
+args = parser.parse_args(sys.argv[1:])
+
+with open(args.trace, "rb") as fd:
+  events = convert(fd.read())
+
+output = {"traceEvents": events, "displayTimeUnit": "ns"}
+if args.json is None:
+  json.dump(output, sys.stdout)
+else:
+  with open(args.json, "w") as fd:
+    json.dump(output, fd)
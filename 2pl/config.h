@@ -0,0 +1,28 @@
+#pragma once
+
+// Compile-time options of the transaction manager. Each option can be
+// overridden from the command line, e.g. make CC="cc -DLOCK_SHIFT=22".
+
+// log2 of the number of reader-writer locks. Words are mapped to the locks by
+// address, distinct words may share a lock.
+#ifndef LOCK_SHIFT
+#define LOCK_SHIFT 20
+#endif
+
+// Time after which a transaction waiting for a lock gives up and aborts, which
+// breaks deadlocks (in microseconds, per lock the transaction holds)
+#ifndef LOCK_TIMEOUT_US
+#define LOCK_TIMEOUT_US 20
+#endif
+
+// Number of failed attempts at taking a lock before yielding the processor
+// between attempts
+#ifndef LOCK_SPINS
+#define LOCK_SPINS 64
+#endif
+
+// log2 of the longest back-off (in units of LOCK_TIMEOUT_US) of a thread whose
+// transactions keep aborting, before it retries
+#ifndef BACKOFF_MAX_SHIFT
+#define BACKOFF_MAX_SHIFT 6
+#endif
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "config.h"
+#include "macros.h"
+
+// Reader-writer lock: LOCK_WRITER when held by a writer, otherwise the number
+// of readers holding it
+typedef atomic_uint rwlock_t;
+
+#define LOCK_WRITER (1u << 31)
+
+// Header of a segment, the segment follows it at seg_header_size(reg) bytes
+struct Segment {
+  struct Segment *prev;
+  struct Segment *next;
+};
+
+struct Region {
+  void *start;              // First, non-freeable segment
+  size_t size;              // Size of the first segment (in bytes)
+  size_t align;             // Alignment of the words (in bytes)
+  unsigned int align_shift; // log2 of the alignment
+  rwlock_t *locks;          // (1 << LOCK_SHIFT) reader-writer locks
+
+  pthread_mutex_t segments_lock;
+  struct Segment *segments; // Segments allocated, but the first
+};
+
+static inline uint32_t word_stripe(struct Region *reg, void const *address) {
+  return ((uintptr_t)address >> reg->align_shift) &
+         (((uintptr_t)1 << LOCK_SHIFT) - 1);
+}
+
+// Under two-phase locking, no transaction can still access a segment once a
+// transaction freeing it commits: it would hold a lock on a word pointing to
+// it, which the freeing transaction must have written. Segments are then
+// given back to the system at once.
+void *seg_alloc(struct Region *reg, size_t size);
+void seg_free(struct Region *reg, void *segment);
+void seg_destroy_all(struct Region *reg);
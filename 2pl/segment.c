@@ -0,0 +1,63 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "region.h"
+
+// The header is padded to the alignment, so that the segment stays aligned
+static size_t seg_header_size(struct Region *reg) {
+  return (sizeof(struct Segment) + reg->align - 1) & ~(reg->align - 1);
+}
+
+void *seg_alloc(struct Region *reg, size_t size) {
+  size_t align = reg->align < sizeof(void *) ? sizeof(void *) : reg->align;
+  struct Segment *seg;
+
+  if (unlikely(posix_memalign((void **)&seg, align,
+                              seg_header_size(reg) + size) != 0)) {
+    return NULL;
+  }
+
+  pthread_mutex_lock(&reg->segments_lock);
+  seg->prev = NULL;
+  seg->next = reg->segments;
+  if (seg->next != NULL) {
+    seg->next->prev = seg;
+  }
+  reg->segments = seg;
+  pthread_mutex_unlock(&reg->segments_lock);
+
+  void *segment = (char *)seg + seg_header_size(reg);
+
+  memset(segment, 0, size);
+
+  return segment;
+}
+
+void seg_free(struct Region *reg, void *segment) {
+  struct Segment *seg =
+      (struct Segment *)((char *)segment - seg_header_size(reg));
+
+  pthread_mutex_lock(&reg->segments_lock);
+  if (seg->prev != NULL) {
+    seg->prev->next = seg->next;
+  } else {
+    reg->segments = seg->next;
+  }
+  if (seg->next != NULL) {
+    seg->next->prev = seg->prev;
+  }
+  pthread_mutex_unlock(&reg->segments_lock);
+
+  free(seg);
+}
+
+void seg_destroy_all(struct Region *reg) {
+  while (reg->segments != NULL) {
+    struct Segment *next = reg->segments->next;
+
+    free(reg->segments);
+    reg->segments = next;
+  }
+}
@@ -0,0 +1,224 @@
+/**
+ * @file   tm.c
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Two-phase locking transaction manager: address-hashed reader-writer locks,
+ * all held until the end of the transaction, in-place writes with an undo log,
+ * and abort on lock wait timeout to break deadlocks.
+ **/
+
+// Requested features
+#define _GNU_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#ifdef __STDC_NO_ATOMICS__
+#error Current C11 compiler does not support atomic operations
+#endif
+
+// External headers
+#include <stdlib.h>
+#include <string.h>
+
+// Internal headers
+#include <tm.h>
+
+#include "macros.h"
+#include "region.h"
+#include "tx.h"
+
+/** Create (i.e. allocate + init) a new shared memory region, with one first
+ *non-free-able allocated segment of the requested size and alignment.
+ * @param size  Size of the first shared segment of memory to allocate (in
+ *bytes), must be a positive multiple of the alignment
+ * @param align Alignment (in bytes, must be a power of 2) that the shared
+ *memory region must support
+ * @return Opaque shared memory region handle, 'invalid_shared' on failure
+ **/
+shared_t tm_create(size_t size, size_t align) {
+  struct Region *reg = (struct Region *)calloc(1, sizeof(struct Region));
+
+  if (unlikely(reg == NULL)) {
+    return invalid_shared;
+  }
+
+  reg->size = size;
+  reg->align = align;
+  reg->align_shift = __builtin_ctzl(align);
+  reg->locks = (rwlock_t *)calloc((size_t)1 << LOCK_SHIFT, sizeof(rwlock_t));
+
+  if (unlikely(reg->locks == NULL)) {
+    free(reg);
+    return invalid_shared;
+  }
+
+  if (unlikely(posix_memalign(&reg->start,
+                              align < sizeof(void *) ? sizeof(void *) : align,
+                              size) != 0)) {
+    free(reg->locks);
+    free(reg);
+    return invalid_shared;
+  }
+
+  memset(reg->start, 0, size);
+  pthread_mutex_init(&reg->segments_lock, NULL);
+
+  return reg;
+}
+
+/** Destroy (i.e. clean-up + free) a given shared memory region.
+ * @param shared Shared memory region to destroy, with no running transaction
+ **/
+void tm_destroy(shared_t shared) {
+  struct Region *reg = (struct Region *)shared;
+
+  seg_destroy_all(reg);
+  pthread_mutex_destroy(&reg->segments_lock);
+  free(reg->start);
+  free(reg->locks);
+  free(reg);
+}
+
+/** [thread-safe] Return the start address of the first allocated segment in the
+ *shared memory region.
+ * @param shared Shared memory region to query
+ * @return Start address of the first allocated segment
+ **/
+void *tm_start(shared_t shared) { return ((struct Region *)shared)->start; }
+
+/** [thread-safe] Return the size (in bytes) of the first allocated segment of
+ *the shared memory region.
+ * @param shared Shared memory region to query
+ * @return First allocated segment size
+ **/
+size_t tm_size(shared_t shared) { return ((struct Region *)shared)->size; }
+
+/** [thread-safe] Return the alignment (in bytes) of the memory accesses on the
+ *given shared memory region.
+ * @param shared Shared memory region to query
+ * @return Alignment used globally
+ **/
+size_t tm_align(shared_t shared) { return ((struct Region *)shared)->align; }
+
+/** [thread-safe] Begin a new transaction on the given shared memory region.
+ * @param shared Shared memory region to start a transaction on
+ * @param is_ro  Whether the transaction is read-only
+ * @return Opaque transaction ID, 'invalid_tx' on failure
+ **/
+tx_t tm_begin(shared_t shared, bool is_ro) {
+  struct Transaction *tx = tx_begin((struct Region *)shared, is_ro);
+
+  if (unlikely(tx == NULL)) {
+    return invalid_tx;
+  }
+
+  return (tx_t)tx;
+}
+
+/** [thread-safe] End the given transaction.
+ * @param shared Shared memory region associated with the transaction
+ * @param tx     Transaction to end
+ * @return Whether the whole transaction committed
+ **/
+bool tm_end(shared_t unused(shared), tx_t tx) {
+  struct Transaction *tr = (struct Transaction *)tx;
+  tx_commit(tr);
+  tx_end(tr);
+
+  return true;
+}
+
+/** [thread-safe] Read operation in the given transaction, source in the shared
+ *region and target in a private region.
+ * @param shared Shared memory region associated with the transaction
+ * @param tx     Transaction to use
+ * @param source Source start address (in the shared region)
+ * @param size   Length to copy (in bytes), must be a positive multiple of the
+ *alignment
+ * @param target Target start address (in a private region)
+ * @return Whether the whole transaction can continue
+ **/
+bool tm_read(shared_t shared, tx_t tx, void const *source, size_t size,
+             void *target) {
+  struct Transaction *tr = (struct Transaction *)tx;
+  size_t align = ((struct Region *)shared)->align;
+
+  for (size_t i = 0; i < size; i += align) {
+    if (!tx_read(tr, (char const *)source + i, (char *)target + i)) {
+      tx_abort(tr);
+      tx_end(tr);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/** [thread-safe] Write operation in the given transaction, source in a private
+ *region and target in the shared region.
+ * @param shared Shared memory region associated with the transaction
+ * @param tx     Transaction to use
+ * @param source Source start address (in a private region)
+ * @param size   Length to copy (in bytes), must be a positive multiple of the
+ *alignment
+ * @param target Target start address (in the shared region)
+ * @return Whether the whole transaction can continue
+ **/
+bool tm_write(shared_t shared, tx_t tx, void const *source, size_t size,
+              void *target) {
+  struct Transaction *tr = (struct Transaction *)tx;
+  size_t align = ((struct Region *)shared)->align;
+
+  for (size_t i = 0; i < size; i += align) {
+    if (!tx_write(tr, (char const *)source + i, (char *)target + i)) {
+      tx_abort(tr);
+      tx_end(tr);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/** [thread-safe] Memory allocation in the given transaction.
+ * @param shared Shared memory region associated with the transaction
+ * @param tx     Transaction to use
+ * @param size   Allocation requested size (in bytes), must be a positive
+ *multiple of the alignment
+ * @param target Pointer in private memory receiving the address of the first
+ *byte of the newly allocated, aligned segment
+ * @return Whether the whole transaction can continue (success/nomem), or not
+ *(abort_alloc)
+ **/
+alloc_t tm_alloc(shared_t shared, tx_t tx, size_t size, void **target) {
+  struct Transaction *tr = (struct Transaction *)tx;
+  void *segment = seg_alloc((struct Region *)shared, size);
+
+  if (unlikely(segment == NULL)) {
+    return nomem_alloc;
+  }
+
+  insert_list(&tr->alloced, segment, void *);
+  *target = segment;
+
+  return success_alloc;
+}
+
+/** [thread-safe] Memory freeing in the given transaction.
+ * @param shared Shared memory region associated with the transaction
+ * @param tx     Transaction to use
+ * @param target Address of the first byte of the previously allocated segment
+ *to deallocate
+ * @return Whether the whole transaction can continue
+ **/
+bool tm_free(shared_t unused(shared), tx_t tx, void *target) {
+  struct Transaction *tr = (struct Transaction *)tx;
+
+  // Only freed at commit, the segment can still be written before
+  insert_list(&tr->freed, target, void *);
+
+  return true;
+}
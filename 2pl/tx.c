@@ -0,0 +1,346 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "tx.h"
+
+#define INDEX_INIT_BITS 8
+
+// Transaction of the calling thread, reused from one transaction to the next
+// so that its logs keep their capacity. Freed when the thread exits.
+static _Thread_local struct Transaction *cached_tx = NULL;
+static pthread_key_t cached_tx_key;
+static pthread_once_t cached_tx_once = PTHREAD_ONCE_INIT;
+
+static struct Transaction *tx_create(void) {
+  struct Transaction *tx =
+      (struct Transaction *)calloc(1, sizeof(struct Transaction));
+
+  if (unlikely(tx == NULL)) {
+    return NULL;
+  }
+
+  init_list(&tx->held, sizeof(struct Held));
+  init_list(&tx->writes, sizeof(void *));
+  init_list(&tx->alloced, sizeof(void *));
+  init_list(&tx->freed, sizeof(void *));
+
+  return tx;
+}
+
+static void tx_destroy(void *arg) {
+  struct Transaction *tx = (struct Transaction *)arg;
+
+  destroy_list(&tx->held);
+  destroy_list(&tx->writes);
+  destroy_list(&tx->alloced);
+  destroy_list(&tx->freed);
+  free(tx->index);
+  free(tx->old);
+  free(tx);
+}
+
+static void cached_tx_init(void) {
+  pthread_key_create(&cached_tx_key, tx_destroy);
+}
+
+// Let the transactions that made the previous attempt(s) time out finish,
+// instead of running into them again. Sleeping leaves them the processor.
+static void backoff(unsigned int aborts) {
+  unsigned int shift = aborts < BACKOFF_MAX_SHIFT ? aborts : BACKOFF_MAX_SHIFT;
+  uint64_t us = LOCK_TIMEOUT_US << shift;
+  struct timespec ts = {.tv_sec = us / 1000000,
+                        .tv_nsec = (us % 1000000) * 1000};
+
+  nanosleep(&ts, NULL);
+}
+
+struct Transaction *tx_begin(struct Region *reg, bool is_ro) {
+  struct Transaction *tx = cached_tx;
+
+  // A thread running transactions on several regions at once gets a fresh
+  // transaction for all but the first one
+  if (unlikely(tx == NULL || tx->in_use)) {
+    tx = tx_create();
+
+    if (unlikely(tx == NULL)) {
+      return NULL;
+    }
+
+    if (cached_tx == NULL) {
+      pthread_once(&cached_tx_once, cached_tx_init);
+      pthread_setspecific(cached_tx_key, tx);
+      cached_tx = tx;
+    }
+  }
+
+  if (tx->aborts > 0) {
+    backoff(tx->aborts);
+  }
+
+  tx->reg = reg;
+  tx->is_ro = is_ro;
+  tx->in_use = tx == cached_tx;
+
+  return tx;
+}
+
+// Release every lock, the shrinking phase
+static void release_all(struct Transaction *tx) {
+  for (size_t i = 0; i < tx->held.n; ++i) {
+    struct Held *held = &get_list(&tx->held, i, struct Held);
+    rwlock_t *lock = &tx->reg->locks[held->stripe];
+
+    if (held->write) {
+      atomic_store_explicit(lock, 0, memory_order_release);
+    } else {
+      atomic_fetch_sub_explicit(lock, 1, memory_order_release);
+    }
+  }
+}
+
+void tx_end(struct Transaction *tx) {
+  release_all(tx);
+
+  if (tx->held.n > 0) {
+    memset(tx->index, 0, sizeof(uint32_t) << tx->index_bits);
+  }
+
+  tx->held.n = 0;
+  tx->writes.n = 0;
+  tx->alloced.n = 0;
+  tx->freed.n = 0;
+
+  if (tx == cached_tx) {
+    tx->in_use = false;
+  } else {
+    tx_destroy(tx);
+  }
+}
+
+static inline size_t held_hash(struct Transaction *tx, uint32_t stripe) {
+  return ((uint64_t)stripe * UINT64_C(0x9E3779B97F4A7C15)) >>
+         (64 - tx->index_bits);
+}
+
+// Lock of the given stripe held by the transaction, NULL if none
+static struct Held *held_find(struct Transaction *tx, uint32_t stripe) {
+  size_t mask = ((size_t)1 << tx->index_bits) - 1;
+
+  for (size_t slot = held_hash(tx, stripe);; slot = (slot + 1) & mask) {
+    uint32_t entry = tx->index[slot];
+
+    if (entry == 0) {
+      return NULL;
+    }
+    if (get_list(&tx->held, entry - 1, struct Held).stripe == stripe) {
+      return &get_list(&tx->held, entry - 1, struct Held);
+    }
+  }
+}
+
+static void held_index(struct Transaction *tx, size_t i) {
+  size_t mask = ((size_t)1 << tx->index_bits) - 1;
+  size_t slot = held_hash(tx, get_list(&tx->held, i, struct Held).stripe);
+
+  while (tx->index[slot] != 0) {
+    slot = (slot + 1) & mask;
+  }
+
+  tx->index[slot] = i + 1;
+}
+
+// Keep the index at most half full
+static bool held_grow(struct Transaction *tx) {
+  unsigned int bits = tx->index == NULL ? INDEX_INIT_BITS : tx->index_bits + 1;
+  uint32_t *index = calloc((size_t)1 << bits, sizeof(uint32_t));
+
+  if (unlikely(index == NULL)) {
+    return false;
+  }
+
+  free(tx->index);
+  tx->index = index;
+  tx->index_bits = bits;
+
+  for (size_t i = 0; i < tx->held.n; ++i) {
+    held_index(tx, i);
+  }
+
+  return true;
+}
+
+static bool held_add(struct Transaction *tx, uint32_t stripe, bool write) {
+  if (unlikely(tx->index == NULL ||
+               2 * (tx->held.n + 1) > ((size_t)1 << tx->index_bits)) &&
+      unlikely(!held_grow(tx))) {
+    return false;
+  }
+
+  struct Held held = {.stripe = stripe, .write = write};
+
+  insert_list(&tx->held, held, struct Held);
+  held_index(tx, tx->held.n - 1);
+
+  return true;
+}
+
+static uint64_t now_us(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Atomically replace the lock value by acquired(value), as soon as
+// acquirable(value) holds. Gives up after a timeout, as the holder may be
+// waiting for a lock we hold. The timeout grows with the locks held, so that of
+// two deadlocked transactions the one with less work to lose aborts first.
+static inline bool lock_wait(struct Transaction *tx, rwlock_t *lock,
+                      bool (*acquirable)(unsigned int),
+                      unsigned int (*acquired)(unsigned int)) {
+  uint64_t deadline = 0;
+
+  for (unsigned int attempt = 0;; ++attempt) {
+    unsigned int value = atomic_load_explicit(lock, memory_order_relaxed);
+
+    if (acquirable(value) &&
+        atomic_compare_exchange_weak_explicit(lock, &value, acquired(value),
+                                              memory_order_acquire,
+                                              memory_order_relaxed)) {
+      return true;
+    }
+
+    if (attempt >= LOCK_SPINS) {
+      if (deadline == 0) {
+        deadline = now_us() + LOCK_TIMEOUT_US * (1 + tx->held.n);
+      } else if (now_us() > deadline) {
+        return false;
+      }
+      sched_yield();
+    }
+  }
+}
+
+static bool no_writer(unsigned int value) { return !(value & LOCK_WRITER); }
+static unsigned int one_more_reader(unsigned int value) { return value + 1; }
+static bool free_lock(unsigned int value) { return value == 0; }
+static bool sole_reader(unsigned int value) { return value == 1; }
+static unsigned int writer(unsigned int unused(value)) { return LOCK_WRITER; }
+
+static bool lock_read(struct Transaction *tx, uint32_t stripe) {
+  if (tx->held.n > 0 && held_find(tx, stripe) != NULL) {
+    return true;
+  }
+
+  if (!lock_wait(tx, &tx->reg->locks[stripe], no_writer, one_more_reader)) {
+    return false;
+  }
+
+  if (unlikely(!held_add(tx, stripe, false))) {
+    atomic_fetch_sub(&tx->reg->locks[stripe], 1);
+    return false;
+  }
+
+  return true;
+}
+
+static bool lock_write(struct Transaction *tx, uint32_t stripe) {
+  struct Held *held = tx->held.n > 0 ? held_find(tx, stripe) : NULL;
+
+  if (held != NULL) {
+    if (held->write) {
+      return true;
+    }
+
+    // Upgrade, once the other readers are gone
+    if (!lock_wait(tx, &tx->reg->locks[stripe], sole_reader, writer)) {
+      return false;
+    }
+
+    held->write = true;
+
+    return true;
+  }
+
+  if (!lock_wait(tx, &tx->reg->locks[stripe], free_lock, writer)) {
+    return false;
+  }
+
+  if (unlikely(!held_add(tx, stripe, true))) {
+    atomic_store(&tx->reg->locks[stripe], 0);
+    return false;
+  }
+
+  return true;
+}
+
+bool tx_read(struct Transaction *tx, void const *source, void *target) {
+  struct Region *reg = tx->reg;
+
+  if (!lock_read(tx, word_stripe(reg, source))) {
+    return false;
+  }
+
+  memcpy(target, source, reg->align);
+
+  return true;
+}
+
+bool tx_write(struct Transaction *tx, void const *source, void *target) {
+  struct Region *reg = tx->reg;
+  size_t align = reg->align;
+
+  if (!lock_write(tx, word_stripe(reg, target))) {
+    return false;
+  }
+
+  // Save the previous value, to be restored on abort
+  if ((tx->writes.n + 1) * align > tx->old_size) {
+    size_t size = tx->old_size == 0 ? 64 * align : 2 * tx->old_size;
+    char *old = realloc(tx->old, size);
+
+    if (unlikely(old == NULL)) {
+      return false;
+    }
+
+    tx->old = old;
+    tx->old_size = size;
+  }
+
+  memcpy(tx->old + tx->writes.n * align, target, align);
+  insert_list(&tx->writes, target, void *);
+
+  memcpy(target, source, align);
+
+  return true;
+}
+
+// Writes are already in place, only frees remain
+void tx_commit(struct Transaction *tx) {
+  tx->aborts = 0;
+
+  for (size_t i = 0; i < tx->freed.n; ++i) {
+    seg_free(tx->reg, get_list(&tx->freed, i, void *));
+  }
+}
+
+// Restore the written words, latest write first, while the locks are held
+void tx_abort(struct Transaction *tx) {
+  size_t align = tx->reg->align;
+
+  ++tx->aborts;
+
+  for (size_t i = tx->writes.n; i-- > 0;) {
+    memcpy(get_list(&tx->writes, i, void *), tx->old + i * align, align);
+  }
+
+  for (size_t i = 0; i < tx->alloced.n; ++i) {
+    seg_free(tx->reg, get_list(&tx->alloced, i, void *));
+  }
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "region.h"
+#include "simple_list.h"
+
+// A lock held by the transaction
+struct Held {
+  uint32_t stripe;
+  bool write; // Held as a writer
+};
+
+struct Transaction {
+  struct Region *reg;
+  bool is_ro;  // Is read only
+  bool in_use; // Is the cached transaction of its thread, and running
+  unsigned int aborts; // Consecutive aborts of the thread
+
+  // Locks held, released at the end only (two-phase locking)
+  struct List held;        // struct Held
+  uint32_t *index;         // Open-addressing index of held, holding (i + 1)
+  unsigned int index_bits; // log2 of the number of index entries
+
+  // Undo log: the i-th written word (void *) had value old + i * align
+  struct List writes;
+  char *old;
+  size_t old_size; // Capacity of old (in bytes)
+
+  struct List alloced; // Segments allocated (void *)
+  struct List freed;   // Segments to free at commit (void *)
+};
+
+struct Transaction *tx_begin(struct Region *reg, bool is_ro);
+void tx_end(struct Transaction *tx);
+
+bool tx_read(struct Transaction *tx, void const *source, void *target);
+bool tx_write(struct Transaction *tx, void const *source, void *target);
+void tx_commit(struct Transaction *tx);
+void tx_abort(struct Transaction *tx);
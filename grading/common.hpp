@@ -24,6 +24,7 @@
 #pragma once
 
 // External headers
+#include <algorithm>
 #include <atomic>
 #include <chrono>
 #include <condition_variable>
@@ -32,6 +33,7 @@
 #include <exception>
 #include <mutex>
 #include <thread>
+#include <type_traits>
 #include <utility>
 extern "C" {
 #include <time.h>
@@ -199,6 +201,96 @@ public:
     }
 };
 
+/** Latency histogram class, HDR-style: exact below 2^sub_bits ticks, then 2^sub_bits linear buckets per power of 2 (i.e. within ~3% of the value).
+**/
+class Histogram final {
+public:
+    /** Count class.
+    **/
+    using Count = uint_fast64_t;
+    constexpr static unsigned int sub_bits = 5; // log2 of the number of buckets per power of 2
+private:
+    constexpr static size_t sub_count = size_t{1} << sub_bits;
+    constexpr static size_t nbbuckets = (64 - sub_bits + 1) * sub_count;
+    Count counts[nbbuckets]; // Values per bucket
+    Count total;             // Values recorded
+    Chrono::Tick maximum;    // Largest value recorded
+private:
+    /** Get the bucket of a value.
+     * @param value Value to classify
+     * @return Bucket index
+    **/
+    static size_t index(Chrono::Tick value) noexcept {
+        if (value < sub_count)
+            return value;
+        auto exp = static_cast<unsigned int>(63 - __builtin_clzll(value)); // Position of the leading 1
+        return ((exp - sub_bits + 1) << sub_bits) + ((value >> (exp - sub_bits)) & (sub_count - 1));
+    }
+    /** Get the largest value of a bucket.
+     * @param index Bucket index
+     * @return Largest value the bucket holds
+    **/
+    static Chrono::Tick highest(size_t index) noexcept {
+        if (index < sub_count)
+            return index;
+        auto exp = static_cast<unsigned int>((index >> sub_bits) + sub_bits - 1);
+        auto mantissa = static_cast<Chrono::Tick>((index & (sub_count - 1)) | sub_count);
+        return ((mantissa + 1) << (exp - sub_bits)) - 1;
+    }
+public:
+    /** Empty histogram constructor.
+    **/
+    Histogram() noexcept: counts{}, total{0}, maximum{0} {}
+public:
+    /** Record a value.
+     * @param value Value to record
+    **/
+    void record(Chrono::Tick value) noexcept {
+        ++counts[index(value)];
+        ++total;
+        if (value > maximum)
+            maximum = value;
+    }
+    /** Add the values of another histogram to this one.
+     * @param other Histogram to merge
+    **/
+    void merge(Histogram const& other) noexcept {
+        for (size_t i = 0; i < nbbuckets; ++i)
+            counts[i] += other.counts[i];
+        total += other.total;
+        if (other.maximum > maximum)
+            maximum = other.maximum;
+    }
+    /** Get the number of values recorded.
+     * @return Number of values
+    **/
+    auto count() const noexcept {
+        return total;
+    }
+    /** Get the largest value recorded.
+     * @return Largest value, 0 if none
+    **/
+    auto max() const noexcept {
+        return maximum;
+    }
+    /** Get a percentile of the values recorded.
+     * @param percent Percentile, in [0, 100]
+     * @return Largest value of the bucket holding the percentile (at most the largest value recorded), 0 if none
+    **/
+    Chrono::Tick percentile(double percent) const noexcept {
+        auto rank = static_cast<Count>(percent / 100. * static_cast<double>(total) + 0.5);
+        if (rank == 0)
+            rank = 1;
+        Count seen = 0;
+        for (size_t i = 0; i < nbbuckets; ++i) {
+            seen += counts[i];
+            if (seen >= rank)
+                return ::std::min(highest(i), maximum);
+        }
+        return maximum;
+    }
+};
+
 /** Atomic waitable latch class.
 **/
 class Latch final {
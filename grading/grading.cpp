@@ -24,13 +24,28 @@
 // External headers
 #include <algorithm>
 #include <atomic>
+#include <cstdlib>
 #include <cstring>
+#include <ctime>
+#include <fstream>
 #include <iostream>
+#include <numeric>
 #include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
 #include <variant>
+#include <vector>
+extern "C" {
+#include <sys/utsname.h>
+#include <unistd.h>
+}
 
 // Internal headers
 #include "common.hpp"
+#include "perf.hpp"
+#include "report.hpp"
+#include "topology.hpp"
 #include "transactional.hpp"
 #include "workload.hpp"
 
@@ -70,7 +85,7 @@ public:
     /** Master trigger "synchronized" execution in all threads (instead of joining).
     **/
     void master_notify() noexcept {
-        status.store(Status::Wait, ::std::memory_order_relaxed);
+        status.store(Status::Wait, ::std::memory_order_release); // Synchronize-with workers waiting, for what the master set before
         runtime.start();
     }
     /** Master trigger termination in all threads (instead of notifying).
@@ -101,7 +116,7 @@ public:
     **/
     bool worker_wait() noexcept {
         while (true) {
-            auto res = status.load(::std::memory_order_relaxed);
+            auto res = status.load(::std::memory_order_acquire); // Synchronize-with 'master_notify'
             if (res == Status::Wait)
                 break;
             if (res == Status::Quit)
@@ -138,20 +153,32 @@ public:
     }
 };
 
-/** Measure the arithmetic mean of the execution time of the given workload with the given transaction library.
+/** Repetitions of the performance measurements.
+**/
+struct Repetitions {
+    unsigned int warmups; // Unmeasured repetitions first (cold caches, page faults, allocator)
+    unsigned int min;     // Minimum number of measured repetitions
+    unsigned int max;     // Maximum number of measured repetitions
+    double       ci;      // Repeat until the 95% confidence interval of the mean is within this fraction of it (0 to stop at 'min')
+};
+
+/** Measure the execution time of the given workload with the given transaction library.
  * @param workload     Workload instance to use
  * @param nbthreads    Number of concurrent threads to use
- * @param nbrepeats    Number of repetitions (keep the median)
+ * @param repeats      Repetitions (keep the median)
  * @param seed         Seed to use for performance measurements
  * @param maxtick_init Timeout for (re)initialization ('Chrono::invalid_tick' for none)
  * @param maxtick_perf Timeout for performance measurements ('Chrono::invalid_tick' for none)
  * @param maxtick_chck Timeout for correctness check ('Chrono::invalid_tick' for none)
- * @return Error constant null-terminated string ('nullptr' for none), execution times (in ns) (undefined if inconsistency detected)
+ * @param perf         Performance counters to run during the measured repetitions
+ * @param placement    CPU to pin each thread to (empty for no pinning)
+ * @return Error constant null-terminated string ('nullptr' for none), execution times (in ns: total at the end of the initialization, median measured repetition, total at the end of the check) (undefined if inconsistency detected), duration of each completed phase in order: initialization, warmups, measured repetitions, check (in ns), statistics of the measured repetitions
 **/
-static auto measure(Workload& workload, unsigned int const nbthreads, unsigned int const nbrepeats, Seed seed, Chrono::Tick maxtick_init, Chrono::Tick maxtick_perf, Chrono::Tick maxtick_chck) {
+static auto measure(Workload& workload, unsigned int const nbthreads, Repetitions const& repeats, Seed seed, Chrono::Tick maxtick_init, Chrono::Tick maxtick_perf, Chrono::Tick maxtick_chck, PerfCounters& perf, ::std::vector<Topology::Cpu> const& placement) {
     ::std::vector<::std::thread> threads(nbthreads);
     ::std::mutex  cerrlock;        // To avoid interleaving writes to 'cerr' in case more than one thread throw
     Sync          sync{nbthreads}; // "As-synchronized-as-possible" starts so that threads interfere "as-much-as-possible"
+    ::std::atomic<bool> repeat{true}; // Whether the next step is another repetition, or the correctness check (set before 'master_notify')
     
     // We start nbthreads threads to measure performance.
     for (unsigned int i = 0; i < nbthreads; ++i) { // Start threads
@@ -165,14 +192,15 @@ static auto measure(Workload& workload, unsigned int const nbthreads, unsigned i
                     if (!sync.worker_wait()) return; // Sync. of threads
                     sync.worker_notify(workload.init()); // Runs the test and tells the master about errors
 
-                    // 2. Performance measurements
-                    for (unsigned int count = 0; count < nbrepeats; ++count) {
+                    // 2. Performance measurements (warmups included), as many as the master asks for
+                    for (unsigned int count = 0;; ++count) {
                         if (!sync.worker_wait()) return;
+                        if (!repeat.load(::std::memory_order_relaxed)) // Synchronized by 'worker_wait'
+                            break;
                         sync.worker_notify(workload.run(i, seed + nbthreads * count + i));
                     }
 
                     // 3. Correctness check
-                    if (!sync.worker_wait()) return;
                     sync.worker_notify(workload.check(i, std::random_device{}())); // Random seed is wanted here
 
                     // Synchronized quit
@@ -187,9 +215,13 @@ static auto measure(Workload& workload, unsigned int const nbthreads, unsigned i
                     return;
                 }
             }, i};
+            if (!placement.empty()) // Before the initialization, the worker waiting
+                Topology::pin(threads[i], placement[i]);
         } catch (...) {
-            for (unsigned int j = 0; j < i; ++j) // Detach threads to avoid termination due to attached thread going out of scope
-                threads[j].detach();
+            for (unsigned int j = 0; j <= i; ++j) { // Detach threads to avoid termination due to attached thread going out of scope
+                if (threads[j].joinable())
+                    threads[j].detach();
+            }
             throw;
         }
     }
@@ -201,9 +233,15 @@ static auto measure(Workload& workload, unsigned int const nbthreads, unsigned i
     try {
         char const* error = nullptr;
         Chrono::Tick time_init = Chrono::invalid_tick;
-        Chrono::Tick times[nbrepeats];
         Chrono::Tick time_chck = Chrono::invalid_tick;
-        auto const posmedian = nbrepeats / 2;
+        ::std::vector<Chrono::Tick> phases; // Durations, the runtime accumulating over the phases
+        ::std::vector<double> times;        // Of the measured repetitions
+        Summary summary;
+        Chrono::Tick elapsed = 0;
+        auto phase = [&](Chrono::Tick time) {
+            phases.push_back(time - elapsed);
+            elapsed = time;
+        };
         { // Initialization (with cheap correctness test)
             sync.master_notify(); // We tell workers to start working.
             auto res = sync.master_wait(maxtick_init); // If running the student's version, it will timeout if way slower than the reference.
@@ -212,20 +250,35 @@ static auto measure(Workload& workload, unsigned int const nbthreads, unsigned i
                 goto join;
             }
             time_init = ::std::get<Chrono>(res).get_tick();
+            phase(time_init);
         }
-        { // Performance measurements (with cheap correctness tests)
-            for (unsigned int i = 0; i < nbrepeats; ++i) {
+        { // Performance measurements (with cheap correctness tests), until the confidence interval is narrow enough
+            for (unsigned int i = 0; i < repeats.warmups + repeats.max; ++i) {
+                if (i == repeats.warmups) { // Measure from here
+                    workload.reset();
+                    perf.start();
+                }
                 sync.master_notify();
                 auto res = sync.master_wait(maxtick_perf);
                 if (unlikely(::std::holds_alternative<char const*>(res))) {
+                    perf.stop();
                     error = ::std::get<char const*>(res);
                     goto join;
                 }
-                times[i] = ::std::get<Chrono>(res).get_tick();
+                phase(::std::get<Chrono>(res).get_tick());
+                if (i < repeats.warmups)
+                    continue;
+                times.push_back(static_cast<double>(phases.back()));
+                if (times.size() < repeats.min)
+                    continue;
+                summary = Summary{times};
+                if (repeats.ci <= 0. || summary.ci_width() <= repeats.ci)
+                    break;
             }
-            ::std::nth_element(times, times + posmedian, times + nbrepeats); // Partition times around the median
+            perf.stop();
         }
         { // Correctness check
+            repeat.store(false, ::std::memory_order_relaxed);
             sync.master_notify();
             auto res = sync.master_wait(maxtick_chck);
             if (unlikely(::std::holds_alternative<char const*>(res))) {
@@ -233,13 +286,14 @@ static auto measure(Workload& workload, unsigned int const nbthreads, unsigned i
                 goto join;
             }
             time_chck = ::std::get<Chrono>(res).get_tick();
+            phase(time_chck);
         }
         join: { // Joining
             sync.master_join(); // Join with threads
             for (unsigned int i = 0; i < nbthreads; ++i)
                 threads[i].join();
         }
-        return ::std::make_tuple(error, time_init, times[posmedian], time_chck);
+        return ::std::make_tuple(error, time_init, static_cast<Chrono::Tick>(summary.median), time_chck, phases, summary);
     } catch (...) {
         for (unsigned int i = 0; i < nbthreads; ++i) // Detach threads to avoid termination due to attached thread going out of scope
             threads[i].detach();
@@ -249,6 +303,252 @@ static auto measure(Workload& workload, unsigned int const nbthreads, unsigned i
 
 // -------------------------------------------------------------------------- //
 
+/** Match a '--name=value' command line option.
+ * @param arg  Command line argument
+ * @param name Option name, including the leading '--'
+ * @return Null-terminated value, 'nullptr' if the argument is not that option
+**/
+static char const* option(char const* arg, char const* name) {
+    auto len = ::std::strlen(name);
+    if (::std::strncmp(arg, name, len) != 0 || arg[len] != '=')
+        return nullptr;
+    return arg + len + 1;
+}
+
+/** Thread counts to sweep.
+ * @param spec      'auto' (1, 2, 4... up to and including the hardware concurrency, then twice it), or comma-separated list of counts
+ * @param nbworkers Hardware concurrency
+ * @return Thread counts, in the given order, 1 first if the list does not have it (the speedups are versus one thread)
+**/
+static ::std::vector<size_t> sweep_counts(::std::string const& spec, size_t nbworkers) {
+    ::std::vector<size_t> counts;
+    if (spec == "auto") {
+        for (size_t count = 1; count < nbworkers; count *= 2)
+            counts.push_back(count);
+        counts.push_back(nbworkers);
+        counts.push_back(2 * nbworkers); // Oversubscribed
+        return counts;
+    }
+    size_t pos = 0;
+    while (pos < spec.size()) {
+        auto end = spec.find(',', pos);
+        if (end == ::std::string::npos)
+            end = spec.size();
+        auto count = ::std::stoul(spec.substr(pos, end - pos));
+        if (count == 0)
+            throw ::std::invalid_argument{"thread count must be positive"};
+        counts.push_back(count);
+        pos = end + 1;
+    }
+    if (counts.empty())
+        throw ::std::invalid_argument{"no thread count to sweep"};
+    if (::std::find(counts.begin(), counts.end(), 1) == counts.end())
+        counts.insert(counts.begin(), 1);
+    return counts;
+}
+
+/** Results of a library at a thread count.
+**/
+struct SweepPoint {
+    char const* library; // Library path
+    size_t  threads;     // #worker threads
+    double  time;        // Median execution time (in ns)
+    double  throughput;  // Committed TX per second
+    double  abort_rate;  // Aborted attempts per attempt
+};
+
+/** Point of a library at one thread, against which its speedups are computed.
+ * @param points  Results
+ * @param library Library path, as in the results
+ * @return Point of the library at one thread (every sweep has that point)
+**/
+static SweepPoint const* sweep_baseline(::std::vector<SweepPoint> const& points, char const* library) {
+    for (auto&& point: points) {
+        if (::std::strcmp(point.library, library) == 0 && point.threads == 1)
+            return &point;
+    }
+    throw Exception::Unreachable{"no 1-thread point in the sweep"};
+}
+
+/** Write the scaling curve of each library: throughput, speedup versus its run with one thread, and abort rate per point.
+ * @param points Results, in sweep order
+ * @param out    Output file stream
+ * @param json   Whether to write JSON, CSV otherwise
+**/
+static void sweep_report(::std::vector<SweepPoint> const& points, ::std::ostream& out, bool json) {
+    if (json) {
+        out << "[";
+    } else {
+        out << "library,threads,time_ns,throughput_tx_per_s,speedup,abort_rate" << ::std::endl;
+    }
+    for (size_t i = 0; i < points.size(); ++i) {
+        auto const& point = points[i];
+        auto speedup = point.throughput / sweep_baseline(points, point.library)->throughput;
+        if (json) {
+            out << (i == 0 ? "" : ",") << ::std::endl << "  {\"library\": \"" << point.library << "\", \"threads\": " << point.threads << ", \"time_ns\": " << point.time << ", \"throughput\": " << point.throughput << ", \"speedup\": " << speedup << ", \"abort_rate\": " << point.abort_rate << "}";
+        } else {
+            out << point.library << "," << point.threads << "," << point.time << "," << point.throughput << "," << speedup << "," << point.abort_rate << ::std::endl;
+        }
+    }
+    if (json)
+        out << ::std::endl << "]" << ::std::endl;
+}
+
+/** Report of a CPU.
+ * @param cpu CPU to report
+ * @return CPU number, package, core and NUMA node
+**/
+static Json cpu_json(Topology::Cpu const& cpu) {
+    Json res;
+    res["cpu"] = cpu.id;
+    res["package"] = cpu.package;
+    res["core"] = cpu.core;
+    res["node"] = cpu.node;
+    return res;
+}
+
+/** Description of the machine and of the run environment.
+ * @param nbworkers Hardware concurrency
+ * @param topology  CPU topology of the process
+ * @return Environment description
+**/
+static Json environment(size_t nbworkers, Topology const& topology) {
+    Json env;
+    char hostname[256];
+    env["hostname"] = ::gethostname(hostname, sizeof(hostname)) == 0 ? Json{hostname} : Json{};
+    struct ::utsname name;
+    if (::uname(&name) == 0) {
+        env["system"] = name.sysname;
+        env["release"] = name.release;
+        env["machine"] = name.machine;
+    }
+    env["hardware_concurrency"] = nbworkers;
+    Json& cpus = env["topology"] = Json::Array{};
+    for (auto&& cpu: topology.get_cpus())
+        cpus.push(cpu_json(cpu));
+    env["compiler"] = __VERSION__;
+    char date[32];
+    auto now = ::std::time(nullptr);
+    struct ::tm utc;
+    env["date"] = ::gmtime_r(&now, &utc) && ::std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", &utc) > 0 ? Json{date} : Json{};
+    Json& tm_env = env["tm_environment"] = Json::Object{}; // Run-time configuration of the libraries
+    for (auto var = environ; *var; ++var) {
+        if (::std::strncmp(*var, "TM_", 3) != 0)
+            continue;
+        auto eq = ::std::strchr(*var, '=');
+        if (eq)
+            tm_env[::std::string{*var, eq}] = eq + 1;
+    }
+    return env;
+}
+
+/** Report of a latency histogram.
+ * @param histogram Histogram to report
+ * @return Count, percentiles and maximum (in ns)
+**/
+static Json latency_json(Histogram const& histogram) {
+    Json res;
+    res["count"] = histogram.count();
+    res["p50"] = histogram.percentile(50.);
+    res["p90"] = histogram.percentile(90.);
+    res["p99"] = histogram.percentile(99.);
+    res["p99.9"] = histogram.percentile(99.9);
+    res["max"] = histogram.max();
+    return res;
+}
+
+/** Report of transaction attempts.
+ * @param attempts Attempts to report
+ * @return Attempts, aborts and times (in ns)
+**/
+static Json attempts_json(Attempts const& attempts) {
+    Json res;
+    res["attempts"] = attempts.attempts;
+    res["aborts"] = attempts.aborts;
+    res["commit_rate"] = attempts.commit_rate();
+    res["aborted_ns"] = attempts.aborted;
+    res["backoff_ns"] = attempts.backoff;
+    return res;
+}
+
+/** Compare the runs of the tested libraries with the same runs (library path and #threads) of a baseline report, annotating them.
+ * A run regresses if its repetitions are significantly slower (one-sided Mann-Whitney U test at 'alpha') and its median is slower by more than 'threshold'.
+ * @param report    Report of this run, whose runs are annotated with the comparison
+ * @param baseline  Baseline report (as written by '--json')
+ * @param path      Baseline file path, to print
+ * @param threshold Relative median slowdown under which a run does not regress
+ * @param alpha     Significance level of the test
+ * @return Whether a run regressed
+**/
+static bool compare_baseline(Json& report, Json const& baseline, char const* path, double threshold, double alpha) {
+    auto samples = [](Json const& run) {
+        ::std::vector<double> res;
+        auto times = run.find("times_ns");
+        auto repeats = times ? times->find("repeats") : nullptr;
+        if (repeats && repeats->is_array()) {
+            for (auto&& time: repeats->as_array())
+                res.push_back(time.as_number());
+        }
+        return res;
+    };
+    auto median = [](::std::vector<double> values) {
+        ::std::sort(values.begin(), values.end());
+        return values.empty() ? 0. : values[values.size() / 2];
+    };
+    ::std::cout << "⎧ Baseline '" << path << "' (regression if slower by more than " << (100. * threshold) << "% with p < " << alpha << ")" << ::std::endl;
+    auto parameter = [](Json const& report, char const* name) { // Run parameter, null if missing
+        auto params = report.find("parameters");
+        auto value = params ? params->find(name) : nullptr;
+        return value ? *value : Json{};
+    };
+    for (auto name: {"seed", "workers", "tx_per_worker", "accounts", "prob_long", "transfer"}) {
+        auto value = parameter(report, name);
+        auto base_value = parameter(baseline, name);
+        auto same = value.is_number() ? base_value.is_number() && value.as_number() == base_value.as_number() : value.is_string() && base_value.is_string() && value.as_string() == base_value.as_string();
+        if (!same)
+            ::std::cout << "⎪ Warning: parameter '" << name << "' differs from the baseline" << ::std::endl;
+    }
+    bool regressed = false;
+    size_t compared = 0;
+    Json::Array const none;
+    auto const* found = baseline.find("runs");
+    auto const& base_runs = found && found->is_array() ? found->as_array() : none;
+    for (auto&& run: report["runs"].as_array()) {
+        if (run["reference"].as_bool() || !run["error"].is_null())
+            continue;
+        Json const* base = nullptr;
+        for (auto&& candidate: base_runs) {
+            auto library = candidate.find("library");
+            auto threads = candidate.find("threads");
+            auto error = candidate.find("error");
+            if (library && library->is_string() && library->as_string() == run["library"].as_string() && threads && threads->is_number() && threads->as_number() == run["threads"].as_number() && (!error || error->is_null())) {
+                base = &candidate;
+                break;
+            }
+        }
+        ::std::cout << "⎪ " << run["library"].as_string() << " @ " << run["threads"].as_number() << " threads: ";
+        if (!base) {
+            ::std::cout << "not in the baseline" << ::std::endl;
+            continue;
+        }
+        auto current = samples(run);
+        auto previous = samples(*base);
+        auto change = median(current) / median(previous) - 1.;
+        auto pvalue = mann_whitney(current, previous);
+        auto regression = pvalue < alpha && change > threshold;
+        ::std::cout << (median(current) / 1000000.) << " ms vs " << (median(previous) / 1000000.) << " ms (" << (change >= 0. ? "+" : "") << (100. * change) << "%, p = " << pvalue << ")" << (regression ? " -> REGRESSION" : "") << ::std::endl;
+        Json& comparison = run["baseline"];
+        comparison["median_ns"] = median(previous);
+        comparison["change"] = change;
+        comparison["p_value"] = pvalue;
+        comparison["regression"] = regression;
+        regressed = regressed || regression;
+        ++compared;
+    }
+    ::std::cout << "⎩ " << compared << " run(s) compared, " << (regressed ? "significant slowdown" : "no significant slowdown") << ::std::endl;
+    return regressed;
+}
+
 /** Program entry point.
  * @param argc Arguments count
  * @param argv Arguments values
@@ -257,10 +557,84 @@ static auto measure(Workload& workload, unsigned int const nbthreads, unsigned i
 int main(int argc, char** argv) {
     try {
         // Parse command line option(s)
-        if (argc < 3) {
-            ::std::cout << "Usage: " << (argc > 0 ? argv[0] : "grading") << " <seed> <reference library path> <tested library path>..." << ::std::endl;
+        ::std::vector<char const*> args; // Positional arguments
+        ::std::string opt_perf;          // Performance counters to report
+        ::std::string opt_trace;         // Timeline file of the tested libraries (empty for none)
+        size_t opt_accounts  = 0;        // Initial #accounts (0 for default)
+        size_t opt_txperwrk  = 0;        // #TX per worker (0 for default)
+        float  opt_prob_long = -1.f;     // Long TX probability (negative for default)
+        ::std::string opt_sweep;         // Thread counts to sweep ('auto' or comma-separated list, empty for none)
+        ::std::string opt_sweep_out;     // Sweep results file, JSON if ending with '.json', CSV otherwise (empty for none)
+        ::std::string opt_json;          // Machine-readable results file (empty for none)
+        char const* opt_baseline = nullptr; // Results file to compare with (null for none)
+        double opt_threshold = 0.05;     // Relative slowdown from the baseline tolerated
+        bool opt_commutative = false;    // Credit the receiver of transfers with 'tm_add'
+        ::std::string opt_pin;           // Pinning policy or CPU list (empty for none)
+        Repetitions opt_repeats{1, 7, 0, 0.}; // Warmups, min/max measured repetitions (max 0 for default) and target confidence interval
+        for (auto i = 1; i < argc; ++i) {
+            char const* value;
+            if ((value = option(argv[i], "--perf"))) {
+                opt_perf = value;
+            } else if ((value = option(argv[i], "--accounts"))) {
+                opt_accounts = ::std::stoul(value);
+            } else if ((value = option(argv[i], "--tx"))) {
+                opt_txperwrk = ::std::stoul(value);
+            } else if ((value = option(argv[i], "--prob-long"))) {
+                opt_prob_long = ::std::stof(value);
+            } else if ((value = option(argv[i], "--trace"))) {
+                opt_trace = value;
+            } else if ((value = option(argv[i], "--sweep"))) {
+                opt_sweep = value;
+            } else if ((value = option(argv[i], "--sweep-out"))) {
+                opt_sweep_out = value;
+            } else if ((value = option(argv[i], "--json"))) {
+                opt_json = value;
+            } else if ((value = option(argv[i], "--baseline"))) {
+                opt_baseline = value;
+            } else if ((value = option(argv[i], "--baseline-threshold"))) {
+                opt_threshold = ::std::stod(value);
+            } else if ((value = option(argv[i], "--transfer"))) {
+                if (::std::strcmp(value, "add") == 0) {
+                    opt_commutative = true;
+                } else if (::std::strcmp(value, "read-write") != 0) {
+                    throw ::std::invalid_argument{"transfer must be 'read-write' or 'add'"};
+                }
+            } else if ((value = option(argv[i], "--pin"))) {
+                opt_pin = value;
+            } else if ((value = option(argv[i], "--warmups"))) {
+                opt_repeats.warmups = ::std::stoul(value);
+            } else if ((value = option(argv[i], "--repeats"))) {
+                opt_repeats.min = ::std::max(1ul, ::std::stoul(value));
+            } else if ((value = option(argv[i], "--max-repeats"))) {
+                opt_repeats.max = ::std::stoul(value);
+            } else if ((value = option(argv[i], "--ci"))) {
+                opt_repeats.ci = ::std::stod(value);
+            } else {
+                args.push_back(argv[i]);
+            }
+        }
+        if (args.size() < 2) {
+            ::std::cout << "Usage: " << (argc > 0 ? argv[0] : "grading") << " [--perf=<event>,...] [--accounts=<count>] [--tx=<count>] [--prob-long=<probability>] [--trace=<path>] [--sweep=auto|<threads>,...] [--sweep-out=<path>.csv|<path>.json] [--json=<path>] [--baseline=<path> [--baseline-threshold=<fraction>]] [--warmups=<count>] [--repeats=<count>] [--ci=<fraction> [--max-repeats=<count>]] [--pin=<policy>|<cpu>,<cpu>-<cpu>...] [--transfer=read-write|add] <seed> <reference library path> <tested library path>..." << ::std::endl;
+            ::std::cout << "Performance counter events:";
+            for (auto&& event: PerfCounters::events)
+                ::std::cout << " " << event.name;
+            ::std::cout << ::std::endl;
+            ::std::cout << "Pinning policies:";
+            for (auto&& policy: Topology::policies)
+                ::std::cout << " " << policy;
+            ::std::cout << ::std::endl;
             return 1;
         }
+        // Load the baseline first, not to run for nothing
+        Json baseline;
+        if (opt_baseline) {
+            ::std::ifstream in{opt_baseline};
+            ::std::stringstream text;
+            text << in.rdbuf();
+            if (!in)
+                throw ::std::runtime_error{"unable to read the baseline"};
+            baseline = Json::parse(text.str());
+        }
         // Get/set/compute run parameters
         auto const nbworkers = []() {
             auto res = ::std::thread::hardware_concurrency();
@@ -268,25 +642,35 @@ int main(int argc, char** argv) {
                 res = 16;
             return static_cast<size_t>(res);
         }();
-        auto const nbtxperwrk    = 200000ul / nbworkers;
-        auto const nbaccounts    = 32 * nbworkers;
-        auto const expnbaccounts = 256 * nbworkers;
+        auto const nbtxperwrk    = opt_txperwrk > 0 ? opt_txperwrk : 200000ul / nbworkers;
+        auto const nbaccounts    = opt_accounts > 0 ? opt_accounts : 32 * nbworkers;
+        auto const expnbaccounts = 8 * nbaccounts;
         auto const init_balance  = 100ul;
-        auto const prob_long     = 0.5f;
+        auto const prob_long     = opt_prob_long >= 0.f ? opt_prob_long : 0.5f;
         auto const prob_alloc    = 0.01f;
-        auto const nbrepeats     = 7;
-        auto const seed          = static_cast<Seed>(::std::stoul(argv[1]));
+        auto const repeats       = Repetitions{opt_repeats.warmups, opt_repeats.min, ::std::max(opt_repeats.min, opt_repeats.max > 0 ? opt_repeats.max : (opt_repeats.ci > 0. ? 8 * opt_repeats.min : opt_repeats.min)), opt_repeats.ci};
+        auto const seed          = static_cast<Seed>(::std::stoul(args[0]));
         auto const clk_res       = Chrono::get_resolution();
         auto const slow_factor   = 16ul;
+        auto const sweeping      = !opt_sweep.empty();
+        auto const sweep         = sweeping ? sweep_counts(opt_sweep, nbworkers) : ::std::vector<size_t>{nbworkers};
+        auto const pinning       = !opt_pin.empty();
+        Topology const topology;
+        if (pinning) // Check the policy before running
+            topology.place(opt_pin, 1);
         // Print run parameters
         ::std::cout << "⎧ #worker threads:     " << nbworkers << ::std::endl;
         ::std::cout << "⎪ #TX per worker:      " << nbtxperwrk << ::std::endl;
-        ::std::cout << "⎪ #repetitions:        " << nbrepeats << ::std::endl;
+        ::std::cout << "⎪ #repetitions:        " << repeats.min;
+        if (repeats.ci > 0.)
+            ::std::cout << " to " << repeats.max << ", until the 95% CI is within ±" << (100. * repeats.ci) << "% of the mean";
+        ::std::cout << " (after " << repeats.warmups << " warmup(s))" << ::std::endl;
         ::std::cout << "⎪ Initial #accounts:   " << nbaccounts << ::std::endl;
         ::std::cout << "⎪ Expected #accounts:  " << expnbaccounts << ::std::endl;
         ::std::cout << "⎪ Initial balance:     " << init_balance << ::std::endl;
         ::std::cout << "⎪ Long TX probability: " << prob_long << ::std::endl;
         ::std::cout << "⎪ Allocation TX prob.: " << prob_alloc << ::std::endl;
+        ::std::cout << "⎪ Transfer credit:     " << (opt_commutative ? "commutative add (tm_add, read and write without it)" : "read and write") << ::std::endl;
         ::std::cout << "⎪ Slow trigger factor: " << slow_factor << ::std::endl;
         ::std::cout << "⎪ Clock resolution:    ";
         if (unlikely(clk_res == Chrono::invalid_tick)) {
@@ -294,57 +678,243 @@ int main(int argc, char** argv) {
         } else {
             ::std::cout << clk_res << " ns" << ::std::endl;
         }
+        if (sweeping) {
+            ::std::cout << "⎪ Swept #threads:      ";
+            for (auto nbthreads: sweep)
+                ::std::cout << nbthreads << (nbthreads == sweep.back() ? "" : ", ");
+            ::std::cout << " (same #TX in total)" << ::std::endl;
+        }
+        {
+            auto counts = topology.count();
+            ::std::cout << "⎪ CPU topology:        " << topology.get_cpus().size() << " CPU(s), " << ::std::get<0>(counts) << " package(s), " << ::std::get<1>(counts) << " core(s)" << ::std::endl;
+        }
+        ::std::cout << "⎪ Worker pinning:      " << (pinning ? opt_pin : "none") << ::std::endl;
         ::std::cout << "⎩ Seed value:          " << seed << ::std::endl;
-        // Library evaluations
-        double reference = 0.; // Set to avoid irrelevant '-Wmaybe-uninitialized'
-        auto const pertxdiv = static_cast<double>(nbworkers) * static_cast<double>(nbtxperwrk);
-        auto maxtick_init = Chrono::invalid_tick;
-        auto maxtick_perf = Chrono::invalid_tick;
-        auto maxtick_chck = Chrono::invalid_tick;
-        for (auto i = 2; i < argc; ++i) {
-            ::std::cout << "⎧ Evaluating '" << argv[i] << "'" << (maxtick_init == Chrono::invalid_tick ? " (reference)" : "") << "..." << ::std::endl;
-            // Load TM library
-            TransactionalLibrary tl{argv[i]};
-            // Initialize workload (shared memory lifetime bound to workload: created and destroyed at the same time)
-            WorkloadBank bank{tl, nbworkers, nbtxperwrk, nbaccounts, expnbaccounts, init_balance, prob_long, prob_alloc};
-            try {
-                // Actual performance measurements and correctness check
-                auto res = measure(bank, nbworkers, nbrepeats, seed, maxtick_init, maxtick_perf, maxtick_chck);
-                // Check false negative-free correctness
-                auto error = ::std::get<0>(res);
-                if (unlikely(error)) {
-                    ::std::cout << "⎩ " << error << ::std::endl;
-                    return 1;
+        // Machine-readable report
+        Json report;
+        report["version"] = 1;
+        report["environment"] = environment(nbworkers, topology);
+        {
+            Json& params = report["parameters"];
+            params["seed"] = seed;
+            params["workers"] = nbworkers;
+            params["tx_per_worker"] = nbtxperwrk;
+            params["warmups"] = repeats.warmups;
+            params["repeats"] = repeats.min;
+            params["max_repeats"] = repeats.max;
+            params["ci_target"] = repeats.ci;
+            params["accounts"] = nbaccounts;
+            params["expected_accounts"] = expnbaccounts;
+            params["initial_balance"] = init_balance;
+            params["prob_long"] = prob_long;
+            params["prob_alloc"] = prob_alloc;
+            params["transfer"] = opt_commutative ? "add" : "read-write";
+            params["slow_factor"] = slow_factor;
+            params["clock_resolution_ns"] = clk_res == Chrono::invalid_tick ? Json{} : Json{clk_res};
+            params["sweep"] = Json::Array{sweep.begin(), sweep.end()};
+            params["perf"] = opt_perf;
+            params["pinning"] = pinning ? Json{opt_pin} : Json{};
+        }
+        Json& runs = report["runs"] = Json::Array{};
+        int status = 0; // Exit code
+        // Library evaluations, for each thread count
+        auto const pertxdiv_total = static_cast<double>(nbworkers) * static_cast<double>(nbtxperwrk); // Total #TX, kept across a sweep
+        ::std::vector<SweepPoint> points;
+        PerfCounters perf{opt_perf}; // Opened before the workers, to count them
+        for (auto nbthreads: sweep) {
+            if (status != 0)
+                break;
+            auto const nbtxperthr = sweeping ? static_cast<size_t>(pertxdiv_total) / nbthreads : nbtxperwrk;
+            if (sweeping)
+                ::std::cout << "⎧ #worker threads:     " << nbthreads << " (" << nbtxperthr << " TX per worker)" << ::std::endl;
+            double reference = 0.; // Set to avoid irrelevant '-Wmaybe-uninitialized'
+            auto const pertxdiv = static_cast<double>(nbthreads) * static_cast<double>(nbtxperthr);
+            auto const placement = pinning ? topology.place(opt_pin, nbthreads) : ::std::vector<Topology::Cpu>{};
+            auto maxtick_init = Chrono::invalid_tick;
+            auto maxtick_perf = Chrono::invalid_tick;
+            auto maxtick_chck = Chrono::invalid_tick;
+            for (size_t i = 1; i < args.size(); ++i) {
+                ::std::cout << "⎧ Evaluating '" << args[i] << "'" << (maxtick_init == Chrono::invalid_tick ? " (reference)" : "") << "..." << ::std::endl;
+                // Load TM library
+                TransactionalLibrary tl{args[i]};
+                // Trace the run of a tested library (TM_TRACE, read when the region is created), to '<path>.<index>' if there are several, then '.<threads>' if sweeping
+                if (!opt_trace.empty()) {
+                    if (maxtick_init == Chrono::invalid_tick) {
+                        ::unsetenv("TM_TRACE");
+                    } else {
+                        auto path = args.size() > 3 ? opt_trace + "." + ::std::to_string(i - 1) : opt_trace;
+                        if (sweeping)
+                            path += "." + ::std::to_string(nbthreads);
+                        ::setenv("TM_TRACE", path.c_str(), 1);
+                        ::std::cout << "⎪ Trace file: " << path << ::std::endl;
+                    }
+                }
+                Json run;
+                run["library"] = args[i];
+                run["reference"] = maxtick_init == Chrono::invalid_tick;
+                run["threads"] = nbthreads;
+                run["tx_per_worker"] = nbtxperthr;
+                if (pinning) { // Actual placement, the policy wrapping around the CPUs if oversubscribed
+                    Json& cpus = run["placement"] = Json::Array{};
+                    ::std::vector<::std::pair<int, int>> cores; // (package, core) used
+                    ::std::vector<int> packages;
+                    ::std::cout << "⎪ Worker CPUs:";
+                    for (auto&& cpu: placement) {
+                        ::std::cout << " " << cpu.id;
+                        cpus.push(cpu_json(cpu));
+                        if (::std::find(cores.begin(), cores.end(), ::std::make_pair(cpu.package, cpu.core)) == cores.end())
+                            cores.emplace_back(cpu.package, cpu.core);
+                        if (::std::find(packages.begin(), packages.end(), cpu.package) == packages.end())
+                            packages.push_back(cpu.package);
+                    }
+                    ::std::cout << " (" << packages.size() << " package(s), " << cores.size() << " core(s))" << ::std::endl;
                 }
-                // Print results
-                auto tick_init = ::std::get<1>(res);
-                auto tick_perf = ::std::get<2>(res);
-                auto tick_chck = ::std::get<3>(res);
-                auto perfdbl = static_cast<double>(tick_perf);
-                ::std::cout << "⎪ Total user execution time: " << (perfdbl / 1000000.) << " ms";
-                if (maxtick_init == Chrono::invalid_tick) { // Set reference performance
-                    maxtick_init = slow_factor * tick_init;
-                    if (unlikely(maxtick_init == Chrono::invalid_tick)) // Bad luck...
-                        ++maxtick_init;
-                    maxtick_perf = slow_factor * tick_perf;
-                    if (unlikely(maxtick_perf == Chrono::invalid_tick)) // Bad luck...
-                        ++maxtick_perf;
-                    maxtick_chck = slow_factor * tick_chck;
-                    if (unlikely(maxtick_chck == Chrono::invalid_tick)) // Bad luck...
-                        ++maxtick_chck;
-                    reference = perfdbl;
-                } else { // Compare with reference performance
-                    ::std::cout << " -> " << (reference / perfdbl) << " speedup";
+                run["error"] = Json{};
+                // Initialize workload (shared memory lifetime bound to workload: created and destroyed at the same time)
+                WorkloadBank bank{tl, nbthreads, nbtxperthr, nbaccounts, expnbaccounts, init_balance, prob_long, prob_alloc, opt_commutative};
+                try {
+                    // Actual performance measurements and correctness check
+                    auto res = measure(bank, nbthreads, repeats, seed, maxtick_init, maxtick_perf, maxtick_chck, perf, placement);
+                    // Check false negative-free correctness
+                    auto error = ::std::get<0>(res);
+                    if (unlikely(error)) {
+                        ::std::cout << "⎩ " << error << ::std::endl;
+                        run["error"] = error;
+                        runs.push(::std::move(run));
+                        status = 1;
+                        break;
+                    }
+                    // Print results
+                    auto tick_init = ::std::get<1>(res);
+                    auto tick_perf = ::std::get<2>(res);
+                    auto tick_chck = ::std::get<3>(res);
+                    auto perfdbl = static_cast<double>(tick_perf);
+                    {
+                        Json& times = run["times_ns"]; // Of each phase, and as printed
+                        auto const& phases = ::std::get<4>(res);
+                        times["init"] = phases.front();
+                        times["warmups"] = Json::Array{phases.begin() + 1, phases.begin() + 1 + repeats.warmups};
+                        times["repeats"] = Json::Array{phases.begin() + 1 + repeats.warmups, phases.end() - 1};
+                        times["check"] = phases.back();
+                        times["total_user"] = tick_perf;
+                    }
+                    run["average_tx_ns"] = perfdbl / pertxdiv;
+                    auto const& summary = ::std::get<5>(res);
+                    {
+                        Json& stats = run["statistics_ns"]; // Of the measured repetitions
+                        stats["count"] = summary.count;
+                        stats["mean"] = summary.mean;
+                        stats["median"] = summary.median;
+                        stats["stddev"] = summary.stddev;
+                        stats["ci95"] = Json::Array{summary.ci_low, summary.ci_high};
+                        stats["outliers"] = Json::Array{summary.outliers.begin(), summary.outliers.end()};
+                    }
+                    ::std::cout << "⎪ Repetitions: " << summary.count << ", mean " << (summary.mean / 1000000.) << " ms, median " << (summary.median / 1000000.) << " ms, stddev " << (summary.stddev / 1000000.) << " ms, 95% CI [" << (summary.ci_low / 1000000.) << ", " << (summary.ci_high / 1000000.) << "] ms (±" << (100. * summary.ci_width()) << "%)";
+                    if (!summary.outliers.empty()) {
+                        ::std::cout << ", outlier(s):";
+                        for (auto outlier: summary.outliers)
+                            ::std::cout << " #" << (outlier + 1);
+                    }
+                    ::std::cout << ::std::endl;
+                    ::std::cout << "⎪ Total user execution time: " << (perfdbl / 1000000.) << " ms";
+                    if (maxtick_init == Chrono::invalid_tick) { // Set reference performance
+                        maxtick_init = slow_factor * tick_init;
+                        if (unlikely(maxtick_init == Chrono::invalid_tick)) // Bad luck...
+                            ++maxtick_init;
+                        { // Same basis as when the total user time was cumulative: the runtime up to the median repetition, as a single one is too tight
+                            auto const& phases = ::std::get<4>(res);
+                            auto upto = phases.begin() + 1 + repeats.warmups + summary.count / 2 + 1; // Initialization, warmups, then measured repetitions up to the median one
+                            maxtick_perf = slow_factor * ::std::accumulate(phases.begin(), upto, Chrono::Tick{0});
+                        }
+                        if (unlikely(maxtick_perf == Chrono::invalid_tick)) // Bad luck...
+                            ++maxtick_perf;
+                        maxtick_chck = slow_factor * tick_chck;
+                        if (unlikely(maxtick_chck == Chrono::invalid_tick)) // Bad luck...
+                            ++maxtick_chck;
+                        reference = perfdbl;
+                    } else { // Compare with reference performance
+                        ::std::cout << " -> " << (reference / perfdbl) << " speedup";
+                        run["speedup"] = reference / perfdbl;
+                    }
+                    ::std::cout << ::std::endl;
+                    auto latencies = bank.get_latencies();
+                    auto attempts = bank.get_attempts();
+                    for (size_t type = 0; type < WorkloadBank::nbtxtypes; ++type) {
+                        Json& txtype = run["transactions"][WorkloadBank::txtype_names[type]];
+                        txtype["latency_ns"] = latency_json(latencies[type]);
+                        txtype["attempts"] = attempts_json(attempts[type]);
+                    }
+                    for (unsigned int uid = 0; uid < nbthreads; ++uid) {
+                        Json worker;
+                        for (size_t type = 0; type < WorkloadBank::nbtxtypes; ++type) {
+                            Json& txtype = worker[WorkloadBank::txtype_names[type]];
+                            txtype["latency_ns"] = latency_json(bank.get_latencies(uid)[type]);
+                            txtype["attempts"] = attempts_json(bank.get_attempts(uid)[type]);
+                        }
+                        run["workers"].push(::std::move(worker));
+                    }
+                    for (size_t type = 0; type < WorkloadBank::nbtxtypes; ++type) {
+                        auto const& histogram = latencies[type];
+                        if (histogram.count() == 0)
+                            continue;
+                        ::std::cout << "⎪ " << WorkloadBank::txtype_names[type] << " TX latency (" << histogram.count() << " TX): p50 " << histogram.percentile(50.) << " ns, p90 " << histogram.percentile(90.) << " ns, p99 " << histogram.percentile(99.) << " ns, p99.9 " << histogram.percentile(99.9) << " ns, max " << histogram.max() << " ns" << ::std::endl;
+                    }
+                    Attempts all;
+                    for (size_t type = 0; type < WorkloadBank::nbtxtypes; ++type) {
+                        auto const& txattempts = attempts[type];
+                        all.merge(txattempts);
+                        if (txattempts.attempts == 0)
+                            continue;
+                        ::std::cout << "⎪ " << WorkloadBank::txtype_names[type] << " TX attempts: " << txattempts.attempts << ", " << txattempts.aborts << " aborted (" << (100. * txattempts.commit_rate()) << "% commit rate), " << (static_cast<double>(txattempts.aborted) / 1000000.) << " ms in aborted attempts, " << (static_cast<double>(txattempts.backoff) / 1000000.) << " ms backing off" << ::std::endl;
+                    }
+                    run["perf"] = Json::Object{};
+                    perf.for_each([&](PerfCounters::Event const& event, bool available, uint64_t count) {
+                        ::std::cout << "⎪ " << event.descr << ": ";
+                        if (unlikely(!available)) {
+                            ::std::cout << "<unavailable>" << ::std::endl;
+                            run["perf"][event.name] = Json{};
+                            return;
+                        }
+                        ::std::cout << (static_cast<double>(count) / summary.count / pertxdiv) << " per TX" << ::std::endl;
+                        run["perf"][event.name] = static_cast<double>(count) / summary.count / pertxdiv;
+                    });
+                    ::std::cout << "⎩ Average TX execution time: " << (perfdbl / pertxdiv) << " ns" << ::std::endl;
+                    points.push_back(SweepPoint{args[i], nbthreads, perfdbl, pertxdiv / perfdbl * 1e9, 1. - all.commit_rate()});
+                    runs.push(::std::move(run));
+                } catch (::std::exception const& err) { // Special case: cannot unload library with running threads, so print error and quick-exit
+                    ::std::cerr << "⎪ *** EXCEPTION ***" << ::std::endl;
+                    ::std::cerr << "⎩ " << err.what() << ::std::endl;
+                    ::std::quick_exit(2);
                 }
-                ::std::cout << ::std::endl;
-                ::std::cout << "⎩ Average TX execution time: " << (perfdbl / pertxdiv) << " ns" << ::std::endl;
-            } catch (::std::exception const& err) { // Special case: cannot unload library with running threads, so print error and quick-exit
-                ::std::cerr << "⎪ *** EXCEPTION ***" << ::std::endl;
-                ::std::cerr << "⎩ " << err.what() << ::std::endl;
-                ::std::quick_exit(2);
             }
         }
-        return 0;
+        // Scaling curves
+        if (sweeping && status == 0) {
+            ::std::cout << "⎧ Scaling (speedup versus one thread, abort rate):" << ::std::endl;
+            for (auto&& point: points) {
+                auto const* base = sweep_baseline(points, point.library);
+                ::std::cout << (&point == &points.back() ? "⎩ " : "⎪ ") << point.library << " @ " << point.threads << " threads: " << point.throughput << " TX/s, " << (point.throughput / base->throughput) << " speedup, " << (100. * point.abort_rate) << "% aborts" << ::std::endl;
+            }
+            if (!opt_sweep_out.empty()) {
+                ::std::ofstream out{opt_sweep_out};
+                auto json = opt_sweep_out.size() >= 5 && opt_sweep_out.compare(opt_sweep_out.size() - 5, 5, ".json") == 0;
+                sweep_report(points, out, json);
+                if (!out)
+                    throw ::std::runtime_error{"unable to write the sweep results"};
+            }
+        }
+        // Regression check, at 1% significance (exit code 3 on a significant slowdown)
+        if (opt_baseline && status == 0 && compare_baseline(report, baseline, opt_baseline, opt_threshold, 0.01))
+            status = 3;
+        // Machine-readable results
+        if (!opt_json.empty()) {
+            ::std::ofstream out{opt_json};
+            report.dump(out);
+            out << ::std::endl;
+            if (!out)
+                throw ::std::runtime_error{"unable to write the JSON results"};
+        }
+        return status;
     } catch (::std::exception const& err) {
         ::std::cerr << "⎧ *** EXCEPTION ***" << ::std::endl;
         ::std::cerr << "⎩ " << err.what() << ::std::endl;
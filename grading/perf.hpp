@@ -0,0 +1,167 @@
+/**
+ * @file   perf.hpp
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * any later version. Please see https://gnu.org/licenses/gpl.html
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * @section DESCRIPTION
+ *
+ * Hardware performance counters, counted over all the threads of the process.
+**/
+
+#pragma once
+
+// External headers
+#include <cstring>
+#include <string>
+#include <vector>
+extern "C" {
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+}
+
+// Internal headers
+#include "common.hpp"
+
+// -------------------------------------------------------------------------- //
+namespace Exception {
+
+/** Exception tree.
+**/
+EXCEPTION(Perf, Any, "performance counter exception");
+    EXCEPTION(PerfUnknown, Perf, "unknown performance counter event");
+
+}
+// -------------------------------------------------------------------------- //
+
+/** Set of performance counters class.
+**/
+class PerfCounters final: private NonCopyable {
+public:
+    /** Counted event class.
+    **/
+    struct Event {
+        char const* name;  // Name on the command line
+        char const* descr; // Printed description
+        uint32_t    type;  // 'perf_event_attr::type'
+        uint64_t    config; // 'perf_event_attr::config'
+    };
+    /** Supported events.
+    **/
+    constexpr static Event events[] = {
+        {"dtlb", "dTLB load misses", PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+        {"dtlb-store", "dTLB store misses", PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_WRITE << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+        {"cycles", "CPU cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+        {"instructions", "Instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+        {"page-faults", "Page faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+        // Loads hitting a line modified in another core's cache, i.e. true or false sharing (Intel-specific raw events)
+        {"hitm", "Loads hitting modified lines of another core (HITM)", PERF_TYPE_RAW, 0x04d2}, // MEM_LOAD_L3_HIT_RETIRED.XSNP_HITM
+        {"hitm-remote", "Loads hitting modified lines of another socket (remote HITM)", PERF_TYPE_RAW, 0x04d3} // MEM_LOAD_L3_MISS_RETIRED.REMOTE_HITM
+    };
+private:
+    /** Read the current count of a counter.
+     * @param fd Counter file descriptor
+     * @param count Count read
+     * @return Whether the count could be read
+    **/
+    static bool read_count(int fd, uint64_t& count) noexcept {
+        return fd >= 0 && ::read(fd, &count, sizeof(count)) == sizeof(count);
+    }
+private:
+    /** One opened counter.
+    **/
+    struct Counter {
+        Event const* event; // Counted event
+        int          fd;    // Counter file descriptor, -1 if unavailable
+        uint64_t     base;  // Count when last started (counts of exited threads cannot be reset)
+    };
+    ::std::vector<Counter> counters; // Opened counters
+public:
+    /** Deleted copy constructor/assignment.
+    **/
+    PerfCounters(PerfCounters const&) = delete;
+    PerfCounters& operator=(PerfCounters const&) = delete;
+    /** Open the counters, disabled; they count the threads created afterwards.
+     * @param names Comma-separated list of event names (empty for none)
+    **/
+    PerfCounters(::std::string const& names) {
+        size_t pos = 0;
+        while (pos < names.size()) {
+            auto end = names.find(',', pos);
+            if (end == ::std::string::npos)
+                end = names.size();
+            auto name = names.substr(pos, end - pos);
+            pos = end + 1;
+            Event const* event = nullptr;
+            for (auto&& known: events) {
+                if (name == known.name)
+                    event = &known;
+            }
+            if (unlikely(!event))
+                throw Exception::PerfUnknown{};
+            struct ::perf_event_attr attr;
+            ::std::memset(&attr, 0, sizeof(attr));
+            attr.size           = sizeof(attr);
+            attr.type           = event->type;
+            attr.config         = event->config;
+            attr.disabled       = 1;
+            attr.inherit        = 1; // Count the worker threads
+            attr.exclude_kernel = 1;
+            attr.exclude_hv     = 1;
+            auto fd = static_cast<int>(::syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+            counters.push_back(Counter{event, fd, 0});
+        }
+    }
+    /** Close the counters.
+    **/
+    ~PerfCounters() noexcept {
+        for (auto&& counter: counters) {
+            if (counter.fd >= 0)
+                ::close(counter.fd);
+        }
+    }
+public:
+    /** Whether no event is counted.
+     * @return Whether no event is counted
+    **/
+    bool empty() const noexcept {
+        return counters.empty();
+    }
+    /** Start counting from zero.
+    **/
+    void start() noexcept {
+        for (auto&& counter: counters) {
+            if (read_count(counter.fd, counter.base))
+                ::ioctl(counter.fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+    /** Stop counting.
+    **/
+    void stop() noexcept {
+        for (auto&& counter: counters) {
+            if (counter.fd >= 0)
+                ::ioctl(counter.fd, PERF_EVENT_IOC_DISABLE, 0);
+        }
+    }
+    /** Call the given function on each counter, once the counted threads have exited.
+     * @param func Function to call (Event const&, bool available, uint64_t count -> void)
+    **/
+    template<class Func> void for_each(Func&& func) const {
+        for (auto&& counter: counters) {
+            uint64_t count = 0;
+            auto available = read_count(counter.fd, count);
+            func(*counter.event, available, count - counter.base);
+        }
+    }
+};
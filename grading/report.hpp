@@ -0,0 +1,474 @@
+/**
+ * @file   report.hpp
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * any later version. Please see https://gnu.org/licenses/gpl.html
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * @section DESCRIPTION
+ *
+ * Statistics of the measurements, machine-readable results (JSON), and
+ * statistical comparison with a baseline.
+**/
+
+#pragma once
+
+// External headers
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <variant>
+#include <vector>
+
+// Internal headers
+#include "common.hpp"
+
+// -------------------------------------------------------------------------- //
+namespace Exception {
+
+/** Exception tree.
+**/
+EXCEPTION(Json, Any, "JSON exception");
+    EXCEPTION(JsonSyntax, Json, "malformed JSON document");
+    EXCEPTION(JsonType, Json, "unexpected JSON value type");
+
+}
+// -------------------------------------------------------------------------- //
+
+/** JSON value class, objects keeping their keys in insertion order.
+**/
+class Json final {
+public:
+    /** Array and object classes.
+    **/
+    using Array  = ::std::vector<Json>;
+    using Object = ::std::vector<::std::pair<::std::string, Json>>;
+private:
+    ::std::variant<::std::nullptr_t, bool, double, ::std::string, Array, Object> value;
+public:
+    /** Null, boolean, number, string, array and object constructors.
+     * @param value Value to hold
+    **/
+    Json(): value{nullptr} {}
+    Json(::std::nullptr_t): value{nullptr} {}
+    Json(bool value): value{value} {}
+    template<class Type, class = ::std::enable_if_t<::std::is_arithmetic_v<Type>>> Json(Type value): value{static_cast<double>(value)} {}
+    Json(char const* value): value{::std::string{value}} {}
+    Json(::std::string value): value{::std::move(value)} {}
+    Json(Array value): value{::std::move(value)} {}
+    Json(Object value): value{::std::move(value)} {}
+public:
+    /** Type tests.
+     * @return Whether the value is of the tested type
+    **/
+    bool is_null() const noexcept { return ::std::holds_alternative<::std::nullptr_t>(value); }
+    bool is_number() const noexcept { return ::std::holds_alternative<double>(value); }
+    bool is_string() const noexcept { return ::std::holds_alternative<::std::string>(value); }
+    bool is_array() const noexcept { return ::std::holds_alternative<Array>(value); }
+    bool is_object() const noexcept { return ::std::holds_alternative<Object>(value); }
+    /** Typed accesses, throwing 'Exception::JsonType' on another type.
+     * @return Held value
+    **/
+    bool as_bool() const { return get<bool>(); }
+    double as_number() const { return get<double>(); }
+    ::std::string const& as_string() const { return get<::std::string>(); }
+    Array const& as_array() const { return get<Array>(); }
+    Object const& as_object() const { return get<Object>(); }
+    Array& as_array() { return const_cast<Array&>(get<Array>()); }
+    Object& as_object() { return const_cast<Object&>(get<Object>()); }
+    /** Get the member of the given key, inserted null if missing (a null value becomes an empty object first).
+     * @param key Member key
+     * @return Member value
+    **/
+    Json& operator[](::std::string const& key) {
+        if (is_null())
+            value = Object{};
+        auto object = ::std::get_if<Object>(&value);
+        if (unlikely(!object))
+            throw Exception::JsonType{};
+        for (auto&& member: *object) {
+            if (member.first == key)
+                return member.second;
+        }
+        object->emplace_back(key, Json{});
+        return object->back().second;
+    }
+    /** Find the member of the given key.
+     * @param key Member key
+     * @return Member value, 'nullptr' if missing or not an object
+    **/
+    Json const* find(::std::string const& key) const noexcept {
+        auto object = ::std::get_if<Object>(&value);
+        if (!object)
+            return nullptr;
+        for (auto&& member: *object) {
+            if (member.first == key)
+                return &member.second;
+        }
+        return nullptr;
+    }
+    /** Append to the array (a null value becomes an empty array first).
+     * @param item Value to append
+     * @return Appended value
+    **/
+    Json& push(Json item) {
+        if (is_null())
+            value = Array{};
+        auto array = ::std::get_if<Array>(&value);
+        if (unlikely(!array))
+            throw Exception::JsonType{};
+        array->push_back(::std::move(item));
+        return array->back();
+    }
+    /** Write the value, indented by 2 spaces per level.
+     * @param out   Output stream
+     * @param depth Current indentation level
+    **/
+    void dump(::std::ostream& out, unsigned int depth = 0) const {
+        auto indent = [&](unsigned int depth) {
+            out << '\n' << ::std::string(2 * depth, ' ');
+        };
+        if (is_null()) {
+            out << "null";
+        } else if (auto boolean = ::std::get_if<bool>(&value)) {
+            out << (*boolean ? "true" : "false");
+        } else if (auto number = ::std::get_if<double>(&value)) {
+            if (!::std::isfinite(*number)) {
+                out << "null";
+            } else if (*number == ::std::nearbyint(*number) && ::std::fabs(*number) < 9007199254740992.) { // Integral and exact
+                out << static_cast<int64_t>(*number);
+            } else {
+                char buffer[32];
+                ::std::snprintf(buffer, sizeof(buffer), "%.15g", *number);
+                out << buffer;
+            }
+        } else if (auto string = ::std::get_if<::std::string>(&value)) {
+            quote(out, *string);
+        } else if (auto array = ::std::get_if<Array>(&value)) {
+            if (array->empty()) {
+                out << "[]";
+                return;
+            }
+            out << '[';
+            for (size_t i = 0; i < array->size(); ++i) {
+                if (i > 0)
+                    out << ',';
+                indent(depth + 1);
+                (*array)[i].dump(out, depth + 1);
+            }
+            indent(depth);
+            out << ']';
+        } else {
+            auto const& object = ::std::get<Object>(value);
+            if (object.empty()) {
+                out << "{}";
+                return;
+            }
+            out << '{';
+            for (size_t i = 0; i < object.size(); ++i) {
+                if (i > 0)
+                    out << ',';
+                indent(depth + 1);
+                quote(out, object[i].first);
+                out << ": ";
+                object[i].second.dump(out, depth + 1);
+            }
+            indent(depth);
+            out << '}';
+        }
+    }
+    /** Parse a JSON document.
+     * @param text Document
+     * @return Parsed value
+    **/
+    static Json parse(::std::string const& text) {
+        size_t pos = 0;
+        auto res = parse(text, pos);
+        skip(text, pos);
+        if (pos != text.size())
+            throw Exception::JsonSyntax{"trailing characters after the JSON document"};
+        return res;
+    }
+private:
+    /** Typed access helper.
+     * @return Held value
+    **/
+    template<class Type> Type const& get() const {
+        auto res = ::std::get_if<Type>(&value);
+        if (unlikely(!res))
+            throw Exception::JsonType{};
+        return *res;
+    }
+    /** Write a quoted, escaped string.
+     * @param out    Output stream
+     * @param string String to write
+    **/
+    static void quote(::std::ostream& out, ::std::string const& string) {
+        out << '"';
+        for (unsigned char c: string) {
+            switch (c) {
+            case '"': out << "\\\""; break;
+            case '\\': out << "\\\\"; break;
+            case '\n': out << "\\n"; break;
+            case '\r': out << "\\r"; break;
+            case '\t': out << "\\t"; break;
+            default:
+                if (c < 0x20) {
+                    char buffer[8];
+                    ::std::snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+                    out << buffer;
+                } else {
+                    out << c;
+                }
+            }
+        }
+        out << '"';
+    }
+    /** Skip the whitespaces.
+     * @param text Document
+     * @param pos  Position in the document, updated
+    **/
+    static void skip(::std::string const& text, size_t& pos) noexcept {
+        while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\n' || text[pos] == '\r'))
+            ++pos;
+    }
+    /** Parse the value at the given position.
+     * @param text Document
+     * @param pos  Position in the document, updated past the value
+     * @return Parsed value
+    **/
+    static Json parse(::std::string const& text, size_t& pos) {
+        skip(text, pos);
+        if (pos >= text.size())
+            throw Exception::JsonSyntax{"unexpected end of the JSON document"};
+        auto literal = [&](char const* word) {
+            auto len = ::std::char_traits<char>::length(word);
+            if (text.compare(pos, len, word) != 0)
+                throw Exception::JsonSyntax{};
+            pos += len;
+        };
+        switch (text[pos]) {
+        case 'n': literal("null"); return Json{};
+        case 't': literal("true"); return Json{true};
+        case 'f': literal("false"); return Json{false};
+        case '"': return Json{parse_string(text, pos)};
+        case '[': {
+            Array array;
+            skip(text, ++pos);
+            if (pos < text.size() && text[pos] == ']') {
+                ++pos;
+                return Json{::std::move(array)};
+            }
+            while (true) {
+                array.push_back(parse(text, pos));
+                skip(text, pos);
+                if (pos >= text.size())
+                    throw Exception::JsonSyntax{"unexpected end of the JSON document"};
+                if (text[pos++] == ']')
+                    return Json{::std::move(array)};
+                if (text[pos - 1] != ',')
+                    throw Exception::JsonSyntax{"expected ',' or ']' in a JSON array"};
+            }
+        }
+        case '{': {
+            Object object;
+            skip(text, ++pos);
+            if (pos < text.size() && text[pos] == '}') {
+                ++pos;
+                return Json{::std::move(object)};
+            }
+            while (true) {
+                skip(text, pos);
+                if (pos >= text.size() || text[pos] != '"')
+                    throw Exception::JsonSyntax{"expected a key in a JSON object"};
+                auto key = parse_string(text, pos);
+                skip(text, pos);
+                if (pos >= text.size() || text[pos++] != ':')
+                    throw Exception::JsonSyntax{"expected ':' in a JSON object"};
+                object.emplace_back(::std::move(key), parse(text, pos));
+                skip(text, pos);
+                if (pos >= text.size())
+                    throw Exception::JsonSyntax{"unexpected end of the JSON document"};
+                if (text[pos++] == '}')
+                    return Json{::std::move(object)};
+                if (text[pos - 1] != ',')
+                    throw Exception::JsonSyntax{"expected ',' or '}' in a JSON object"};
+            }
+        }
+        default: {
+            char* end;
+            auto number = ::std::strtod(text.c_str() + pos, &end);
+            if (end == text.c_str() + pos)
+                throw Exception::JsonSyntax{};
+            pos = end - text.c_str();
+            return Json{number};
+        }
+        }
+    }
+    /** Parse the string at the given position (on its opening quote).
+     * @param text Document
+     * @param pos  Position in the document, updated past the closing quote
+     * @return Unescaped string (UTF-8)
+    **/
+    static ::std::string parse_string(::std::string const& text, size_t& pos) {
+        ::std::string res;
+        ++pos;
+        while (pos < text.size() && text[pos] != '"') {
+            auto c = text[pos++];
+            if (c != '\\') {
+                res += c;
+                continue;
+            }
+            if (pos >= text.size())
+                break;
+            switch (auto e = text[pos++]) {
+            case 'b': res += '\b'; break;
+            case 'f': res += '\f'; break;
+            case 'n': res += '\n'; break;
+            case 'r': res += '\r'; break;
+            case 't': res += '\t'; break;
+            case 'u': {
+                if (pos + 4 > text.size())
+                    throw Exception::JsonSyntax{"truncated JSON string escape"};
+                auto code = static_cast<unsigned int>(::std::strtoul(text.substr(pos, 4).c_str(), nullptr, 16));
+                pos += 4;
+                if (code < 0x80) { // Code points of the basic multilingual plane only
+                    res += static_cast<char>(code);
+                } else if (code < 0x800) {
+                    res += static_cast<char>(0xC0 | (code >> 6));
+                    res += static_cast<char>(0x80 | (code & 0x3F));
+                } else {
+                    res += static_cast<char>(0xE0 | (code >> 12));
+                    res += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+                    res += static_cast<char>(0x80 | (code & 0x3F));
+                }
+            } break;
+            default: res += e; // '"', '\\' and '/'
+            }
+        }
+        if (pos >= text.size())
+            throw Exception::JsonSyntax{"unterminated JSON string"};
+        ++pos;
+        return res;
+    }
+};
+
+// -------------------------------------------------------------------------- //
+
+/** One-sided Mann-Whitney U test that the samples of 'slow' tend to be greater than those of 'fast', normal approximation with tie and continuity corrections.
+ * @param slow Samples presumed greater
+ * @param fast Samples presumed lower
+ * @return p-value (1 if either set is empty)
+**/
+static double mann_whitney(::std::vector<double> const& slow, ::std::vector<double> const& fast) {
+    auto const n1 = static_cast<double>(slow.size());
+    auto const n2 = static_cast<double>(fast.size());
+    if (slow.empty() || fast.empty())
+        return 1.;
+    double u = 0.; // Pairs where 'slow' is greater, ties counting half
+    for (auto x: slow) {
+        for (auto y: fast)
+            u += x > y ? 1. : (x == y ? 0.5 : 0.);
+    }
+    ::std::vector<double> all{slow};
+    all.insert(all.end(), fast.begin(), fast.end());
+    ::std::sort(all.begin(), all.end());
+    double ties = 0.; // Sum of t^3 - t over the groups of t equal samples
+    for (size_t i = 0; i < all.size();) {
+        size_t j = i;
+        while (j < all.size() && all[j] == all[i])
+            ++j;
+        auto t = static_cast<double>(j - i);
+        ties += t * t * t - t;
+        i = j;
+    }
+    auto const n = n1 + n2;
+    auto const variance = n1 * n2 / 12. * ((n + 1.) - ties / (n * (n - 1.)));
+    if (variance <= 0.) // All samples equal
+        return 1.;
+    auto const z = (u - n1 * n2 / 2. - 0.5) / ::std::sqrt(variance);
+    return 0.5 * ::std::erfc(z / ::std::sqrt(2.));
+}
+
+/** Two-sided 95% quantile of Student's t distribution.
+ * @param df Degrees of freedom (positive)
+ * @return Quantile
+**/
+static double student_t95(size_t df) noexcept {
+    constexpr static double table[] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228, 2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086, 2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+    if (df == 0)
+        return ::std::numeric_limits<double>::infinity();
+    if (df <= sizeof(table) / sizeof(*table))
+        return table[df - 1];
+    return 1.96 + 2.37 / static_cast<double>(df); // Cornish-Fisher expansion, within 0.2% past the table
+}
+
+/** Summary statistics of a set of measurements.
+**/
+class Summary final {
+public:
+    size_t count  = 0;  // Number of samples
+    double mean   = 0.;
+    double median = 0.;
+    double stddev = 0.; // Sample standard deviation
+    double ci_low = 0.; // 95% confidence interval of the mean (Student's t)
+    double ci_high = 0.;
+    ::std::vector<size_t> outliers; // Indices of the samples outside Tukey's fences (1.5 interquartile range), kept in the statistics
+public:
+    /** Empty summary constructor.
+    **/
+    Summary() = default;
+    /** Summary constructor.
+     * @param samples Samples, in order
+    **/
+    Summary(::std::vector<double> const& samples): count{samples.size()} {
+        if (samples.empty())
+            return;
+        ::std::vector<double> sorted{samples};
+        ::std::sort(sorted.begin(), sorted.end());
+        auto quantile = [&](double q) { // Linear interpolation between the closest ranks
+            auto pos = q * static_cast<double>(count - 1);
+            auto low = static_cast<size_t>(pos);
+            return low + 1 < count ? sorted[low] + (pos - static_cast<double>(low)) * (sorted[low + 1] - sorted[low]) : sorted[low];
+        };
+        for (auto sample: samples)
+            mean += sample;
+        mean /= static_cast<double>(count);
+        median = quantile(0.5);
+        if (count > 1) {
+            for (auto sample: samples)
+                stddev += (sample - mean) * (sample - mean);
+            stddev = ::std::sqrt(stddev / static_cast<double>(count - 1));
+        }
+        auto half = count > 1 ? student_t95(count - 1) * stddev / ::std::sqrt(static_cast<double>(count)) : ::std::numeric_limits<double>::infinity();
+        ci_low = mean - half;
+        ci_high = mean + half;
+        auto q1 = quantile(0.25);
+        auto q3 = quantile(0.75);
+        for (size_t i = 0; i < count; ++i) {
+            if (samples[i] < q1 - 1.5 * (q3 - q1) || samples[i] > q3 + 1.5 * (q3 - q1))
+                outliers.push_back(i);
+        }
+    }
+public:
+    /** Get the half width of the confidence interval, relative to the mean.
+     * @return Relative half width (infinite with less than 2 samples)
+    **/
+    double ci_width() const noexcept {
+        return mean > 0. ? (ci_high - ci_low) / 2. / mean : ::std::numeric_limits<double>::infinity();
+    }
+};
@@ -0,0 +1,241 @@
+/**
+ * @file   topology.hpp
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * any later version. Please see https://gnu.org/licenses/gpl.html
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * @section DESCRIPTION
+ *
+ * CPU topology of the machine, and placement of the worker threads on it.
+**/
+
+#pragma once
+
+// External headers
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+extern "C" {
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+}
+
+// Internal headers
+#include "common.hpp"
+
+// -------------------------------------------------------------------------- //
+namespace Exception {
+
+/** Exception tree.
+**/
+EXCEPTION(Topology, Any, "CPU topology exception");
+    EXCEPTION(TopologyPolicy, Topology, "unknown pinning policy or malformed CPU list");
+    EXCEPTION(TopologyCpu, Topology, "CPU not available to the process");
+    EXCEPTION(TopologyAffinity, Topology, "unable to set the CPU affinity of a worker");
+
+}
+// -------------------------------------------------------------------------- //
+
+/** CPU topology class, of the CPUs the process may run on.
+**/
+class Topology final {
+public:
+    /** Logical CPU class.
+    **/
+    struct Cpu {
+        int id;      // Logical CPU number
+        int package; // Physical package (socket)
+        int core;    // Core in its package, shared by SMT siblings
+        int node;    // NUMA node (0 if unknown)
+    };
+    /** Pinning policies.
+    **/
+    constexpr static char const* policies[] = {"compact", "scatter", "cores"};
+private:
+    ::std::vector<Cpu> cpus; // By logical CPU number
+public:
+    /** Detection constructor, from the affinity of the process and sysfs (missing entries default to one core per CPU, one package and one node).
+    **/
+    Topology() {
+        ::cpu_set_t set;
+        if (::sched_getaffinity(0, sizeof(set), &set) != 0) {
+            CPU_ZERO(&set);
+            for (int id = 0; id < static_cast<int>(::std::thread::hardware_concurrency()); ++id)
+                CPU_SET(id, &set);
+        }
+        for (int id = 0; id < CPU_SETSIZE; ++id) {
+            if (!CPU_ISSET(id, &set))
+                continue;
+            auto path = "/sys/devices/system/cpu/cpu" + ::std::to_string(id);
+            cpus.push_back(Cpu{id, read(path + "/topology/physical_package_id", 0), read(path + "/topology/core_id", id), node(path)});
+        }
+    }
+public:
+    /** Get the CPUs of the process.
+     * @return CPUs, by logical CPU number
+    **/
+    auto const& get_cpus() const noexcept {
+        return cpus;
+    }
+    /** Find a CPU of the process.
+     * @param id Logical CPU number
+     * @return CPU, 'nullptr' if not available to the process
+    **/
+    Cpu const* find(int id) const noexcept {
+        for (auto&& cpu: cpus) {
+            if (cpu.id == id)
+                return &cpu;
+        }
+        return nullptr;
+    }
+    /** Count the physical packages and cores.
+     * @return Number of packages, number of cores
+    **/
+    auto count() const {
+        ::std::map<int, int> packages;                  // Cores per package
+        ::std::vector<::std::pair<int, int>> cores;     // (package, core)
+        for (auto&& cpu: cpus) {
+            if (::std::find(cores.begin(), cores.end(), ::std::make_pair(cpu.package, cpu.core)) == cores.end()) {
+                cores.emplace_back(cpu.package, cpu.core);
+                ++packages[cpu.package];
+            }
+        }
+        return ::std::make_tuple(packages.size(), cores.size());
+    }
+    /** Place workers on the CPUs.
+     * @param policy    'compact' (SMT siblings, then cores, then packages filled in turn), 'scatter' (round-robin over the packages, one CPU per core before SMT siblings), 'cores' (one CPU per physical core, in compact order), or comma-separated list of CPUs and CPU ranges (e.g. '0,2,4-7')
+     * @param nbworkers Number of workers
+     * @return CPU of each worker, wrapping around the placement if there are more workers than CPUs
+    **/
+    ::std::vector<Cpu> place(::std::string const& policy, size_t nbworkers) const {
+        ::std::vector<Cpu> order;
+        if (policy == "compact" || policy == "cores") {
+            order = cpus;
+            ::std::sort(order.begin(), order.end(), [](Cpu const& a, Cpu const& b) {
+                return ::std::make_tuple(a.package, a.core, a.id) < ::std::make_tuple(b.package, b.core, b.id);
+            });
+            if (policy == "cores") { // First CPU of each core
+                order.erase(::std::unique(order.begin(), order.end(), [](Cpu const& a, Cpu const& b) {
+                    return a.package == b.package && a.core == b.core;
+                }), order.end());
+            }
+        } else if (policy == "scatter") {
+            ::std::map<int, ::std::vector<Cpu>> packages; // Per package: one CPU of each core, then the next SMT siblings...
+            for (auto&& cpu: cpus)
+                packages[cpu.package].push_back(cpu);
+            for (auto&& package: packages) {
+                auto& list = package.second;
+                ::std::map<int, int> ranks; // SMT rank of each CPU in its core, counted per core
+                ::std::vector<::std::pair<int, Cpu>> ranked;
+                for (auto&& cpu: list)
+                    ranked.emplace_back(ranks[cpu.core]++, cpu);
+                ::std::sort(ranked.begin(), ranked.end(), [](auto const& a, auto const& b) {
+                    return ::std::make_tuple(a.first, a.second.core, a.second.id) < ::std::make_tuple(b.first, b.second.core, b.second.id);
+                });
+                list.clear();
+                for (auto&& item: ranked)
+                    list.push_back(item.second);
+            }
+            for (size_t rank = 0; order.size() < cpus.size(); ++rank) { // Round-robin over the packages
+                for (auto&& package: packages) {
+                    if (rank < package.second.size())
+                        order.push_back(package.second[rank]);
+                }
+            }
+        } else {
+            for (auto&& id: parse(policy)) {
+                auto cpu = find(id);
+                if (!cpu)
+                    throw Exception::TopologyCpu{};
+                order.push_back(*cpu);
+            }
+        }
+        if (order.empty())
+            throw Exception::TopologyPolicy{};
+        ::std::vector<Cpu> res;
+        for (size_t i = 0; i < nbworkers; ++i)
+            res.push_back(order[i % order.size()]);
+        return res;
+    }
+    /** Pin a thread to a CPU.
+     * @param thread Thread to pin
+     * @param cpu    CPU to pin to
+    **/
+    static void pin(::std::thread& thread, Cpu const& cpu) {
+        ::cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu.id, &set);
+        if (unlikely(::pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set) != 0))
+            throw Exception::TopologyAffinity{};
+    }
+private:
+    /** Read an integer from a file.
+     * @param path File path
+     * @param def  Value if the file cannot be read
+     * @return Read value, or the default
+    **/
+    static int read(::std::string const& path, int def) {
+        ::std::ifstream in{path};
+        int res;
+        return in >> res ? res : def;
+    }
+    /** Find the NUMA node of a CPU, from the 'node<n>' entry of its sysfs directory.
+     * @param path CPU sysfs directory
+     * @return Node, 0 if unknown
+    **/
+    static int node(::std::string const& path) {
+        auto dir = ::opendir(path.c_str());
+        if (!dir)
+            return 0;
+        int res = 0;
+        while (auto entry = ::readdir(dir)) {
+            if (::std::strncmp(entry->d_name, "node", 4) == 0 && entry->d_name[4] >= '0' && entry->d_name[4] <= '9') {
+                res = ::std::atoi(entry->d_name + 4);
+                break;
+            }
+        }
+        ::closedir(dir);
+        return res;
+    }
+    /** Parse a list of CPUs and CPU ranges.
+     * @param list Comma-separated list, e.g. '0,2,4-7'
+     * @return CPUs, in order
+    **/
+    static ::std::vector<int> parse(::std::string const& list) {
+        ::std::vector<int> res;
+        size_t pos = 0;
+        while (pos < list.size()) {
+            auto end = list.find(',', pos);
+            if (end == ::std::string::npos)
+                end = list.size();
+            auto item = list.substr(pos, end - pos);
+            if (item.empty() || item.find_first_not_of("0123456789-") != ::std::string::npos)
+                throw Exception::TopologyPolicy{};
+            auto dash = item.find('-');
+            auto first = ::std::stoi(item.substr(0, dash));
+            auto last = dash == ::std::string::npos ? first : ::std::stoi(item.substr(dash + 1));
+            if (last < first)
+                throw Exception::TopologyPolicy{};
+            for (auto id = first; id <= last; ++id)
+                res.push_back(id);
+            pos = end + 1;
+        }
+        return res;
+    }
+};
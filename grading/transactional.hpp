@@ -80,6 +80,8 @@ private:
     using FnWrite   = decltype(&STM::tm_write);
     using FnAlloc   = decltype(&STM::tm_alloc);
     using FnFree    = decltype(&STM::tm_free);
+    using FnAdd     = decltype(&STM::tm_add);
+    using FnWait    = decltype(&STM::tm_should_wait);
 private:
     void*     module;     // Module opaque handler
     FnCreate  tm_create;  // Module's initialization function
@@ -93,6 +95,8 @@ private:
     FnWrite   tm_write;   // Module's shared memory write function
     FnAlloc   tm_alloc;   // Module's shared memory allocation function
     FnFree    tm_free;    // Module's shared memory freeing function
+    FnAdd     tm_add;     // Module's commutative addition function (optional, may be null)
+    FnWait    tm_should_wait; // Module's contention management hook (optional, may be null)
 private:
     /** Solve a symbol from its name, and bind it to the given function.
      * @param name Name of the symbol to resolve
@@ -107,6 +111,14 @@ private:
     template<class Signature> void solve(char const* name, Signature& func) const {
         func = solve<Signature>(name);
     }
+    /** Solve an optional symbol from its name, and bind it to the given function (null if not found).
+     * @param name Name of the symbol to resolve
+     * @param func Target function to bind
+    **/
+    template<class Signature> void solve_optional(char const* name, Signature& func) const {
+        auto res = ::dlsym(module, name);
+        func = res ? *reinterpret_cast<Signature*>(&res) : nullptr;
+    }
 public:
     /** Loader constructor.
      * @param path  Path to the library to load
@@ -132,6 +144,8 @@ public:
             solve("tm_write", tm_write);
             solve("tm_alloc", tm_alloc);
             solve("tm_free", tm_free);
+            solve_optional("tm_add", tm_add);
+            solve_optional("tm_should_wait", tm_should_wait);
         }
     }
     /** Unloader destructor.
@@ -257,6 +271,38 @@ public:
     auto free(TX tx, void* target) const noexcept {
         return tl.tm_free(shared, tx, target);
     }
+    /** [thread-safe] Whether the library provides commutative additions.
+     * @return Whether 'add' can be used
+    **/
+    auto can_add() const noexcept {
+        return tl.tm_add != nullptr;
+    }
+    /** [thread-safe] Commutative addition operation in the given transaction, only if 'can_add'.
+     * @param tx     Transaction to use
+     * @param target Target start address
+     * @param delta  Value to add
+     * @param width  Size of the target integer
+     * @return Whether the whole transaction can continue
+    **/
+    auto add(TX tx, void* target, int64_t delta, size_t width) const noexcept {
+        return tl.tm_add(shared, tx, target, delta, width);
+    }
+    /** [thread-safe] Wait as long as the library's contention manager asks before retrying an aborted transaction.
+    **/
+    void backoff() const {
+        if (!tl.tm_should_wait)
+            return;
+        auto wait = ::std::chrono::nanoseconds{tl.tm_should_wait(shared)};
+        if (wait.count() == 0)
+            return;
+        if (wait >= ::std::chrono::microseconds{50}) { // Long enough to sleep
+            ::std::this_thread::sleep_for(wait);
+            return;
+        }
+        auto deadline = ::std::chrono::steady_clock::now() + wait;
+        while (::std::chrono::steady_clock::now() < deadline)
+            ::std::this_thread::yield();
+    }
 };
 
 /** One transaction over a shared memory region management class.
@@ -327,6 +373,19 @@ public:
             throw Exception::TransactionRetry{};
         }
     }
+    /** [thread-safe] Commutative addition operation in the bound transaction, to an integer in the shared region.
+     * @param target Target start address
+     * @param delta  Value to add
+     * @param width  Size of the target integer
+    **/
+    void add(void* target, int64_t delta, size_t width) {
+        if (unlikely(assert_mode && is_ro))
+            throw Exception::TransactionReadOnly{};
+        if (unlikely(!tm.add(tx, target, delta, width))) {
+            aborted = true;
+            throw Exception::TransactionRetry{};
+        }
+    }
     /** [thread-safe] Memory allocation operation in the bound transaction, throw if no memory available.
      * @param size Size to allocate
      * @return Target start address
@@ -406,6 +465,18 @@ public:
     void operator=(Type const& source) const {
         return write(source);
     }
+    /** Commutative addition operation, a read then a write if the library has no 'tm_add'.
+     * The entry must not be read or written afterwards in the same transaction.
+     * @param delta Private value to add to the content at the shared address
+    **/
+    void operator+=(Type const& delta) const {
+        static_assert(::std::is_integral<Type>::value && sizeof(Type) <= sizeof(int64_t), "Type is not an integer");
+        if (tx.get_tm().can_add()) {
+            tx.add(address, static_cast<int64_t>(delta), sizeof(Type));
+        } else {
+            write(read() + delta);
+        }
+    }
 public:
     /** Address of the first byte after the entry.
      * @return First byte after the entry
@@ -602,6 +673,32 @@ public:
 
 // -------------------------------------------------------------------------- //
 
+/** Attempts accounting class, of the transactions of one type run by one thread.
+**/
+class Attempts final {
+public:
+    uint_fast64_t attempts = 0;   // Attempts begun
+    uint_fast64_t aborts   = 0;   // Of which aborted
+    Chrono::Tick  aborted  = 0;   // Time spent in the aborted attempts (in ns)
+    Chrono::Tick  backoff  = 0;   // Time spent waiting before retries (in ns)
+public:
+    /** Add the counts of another accounting to this one.
+     * @param other Accounting to merge
+    **/
+    void merge(Attempts const& other) noexcept {
+        attempts += other.attempts;
+        aborts   += other.aborts;
+        aborted  += other.aborted;
+        backoff  += other.backoff;
+    }
+    /** Get the fraction of the attempts that committed.
+     * @return Commit rate, 1 if no attempt
+    **/
+    double commit_rate() const noexcept {
+        return attempts == 0 ? 1. : static_cast<double>(attempts - aborts) / static_cast<double>(attempts);
+    }
+};
+
 /** Repeat a given transaction until it commits.
  * @param tm   Transactional memory
  * @param mode Transactional mode
@@ -614,6 +711,33 @@ template<class Func> static auto transactional(TransactionalMemory const& tm, Tr
             Transaction tx{tm, mode};
             return func(tx);
         } catch (Exception::TransactionRetry const&) {
+            tm.backoff();
+            continue;
+        }
+    } while (true);
+}
+
+/** Repeat a given transaction until it commits, accounting for its attempts.
+ * @param tm       Transactional memory
+ * @param mode     Transactional mode
+ * @param attempts Accounting to update
+ * @param func     Transaction closure (Transaction& -> ...)
+ * @return Returned value (or void) when the transaction committed
+**/
+template<class Func> static auto transactional(TransactionalMemory const& tm, Transaction::Mode mode, Attempts& attempts, Func&& func) {
+    Chrono chrono;
+    do {
+        ++attempts.attempts;
+        chrono.start();
+        try {
+            Transaction tx{tm, mode};
+            return func(tx);
+        } catch (Exception::TransactionRetry const&) {
+            ++attempts.aborts;
+            attempts.aborted += chrono.delta();
+            chrono.start();
+            tm.backoff();
+            attempts.backoff += chrono.delta();
             continue;
         }
     } while (true);
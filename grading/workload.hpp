@@ -24,8 +24,10 @@
 #pragma once
 
 // External headers
+#include <array>
 #include <cstdint>
 #include <random>
+#include <vector>
 
 // Internal headers
 #include "common.hpp"
@@ -77,6 +79,9 @@ public:
      * @return Constant null-terminated error message, 'nullptr' for none
     **/
     virtual char const* check(Uid, Seed) const = 0;
+    /** Forget the statistics gathered by the runs so far, e.g. after warmup runs (not thread-safe with 'run').
+    **/
+    virtual void reset() const {}
 };
 
 // -------------------------------------------------------------------------- //
@@ -89,6 +94,21 @@ public:
     **/
     using Balance = intptr_t;
     static_assert(sizeof(Balance) >= sizeof(void*), "Balance class is too small");
+    /** Transaction type enum class, index in the latency histograms.
+    **/
+    enum class TxType: size_t {
+        short_tx,
+        long_tx,
+        alloc_tx
+    };
+    constexpr static size_t nbtxtypes = 3;
+    constexpr static char const* txtype_names[nbtxtypes] = {"short", "long", "alloc"};
+    /** Latency histograms class, one per transaction type.
+    **/
+    using Latencies = ::std::array<Histogram, nbtxtypes>;
+    /** Attempts accounting class, one per transaction type.
+    **/
+    using TxAttempts = ::std::array<Attempts, nbtxtypes>;
 private:
     /** Shared segment of accounts class.
     **/
@@ -140,7 +160,15 @@ private:
     Balance init_balance;  // Initial account balance
     float   prob_long;     // Probability of running a long, read-only control transaction
     float   prob_alloc;    // Probability of running an allocation/deallocation transaction, knowing a long transaction won't run
+    bool    commutative;   // Whether transfers credit the receiver with a commutative addition ('tm_add'), instead of a read and a write
     Barrier barrier;       // Barrier for thread synchronization during 'check'
+    /** Measurements of one worker, on cache lines of its own.
+    **/
+    struct alignas(64) WorkerStats {
+        Latencies  latencies; // Latency (in ns) of each transaction 'run', retries included
+        TxAttempts attempts;  // Attempts of the transactions 'run'
+    };
+    ::std::vector<WorkerStats> mutable workers; // Per worker
 public:
     /** Bank workload constructor.
      * @param library       Transactional library to use
@@ -151,15 +179,17 @@ public:
      * @param init_balance  Initial account balance
      * @param prob_long     Probability of running a long, read-only control transaction
      * @param prob_alloc    Probability of running an allocation/deallocation transaction, knowing a long transaction won't run
+     * @param commutative   Whether transfers credit the receiver with a commutative addition (a different transaction: to compare libraries, all runs must agree on it)
     **/
-    WorkloadBank(TransactionalLibrary const& library, size_t nbworkers, size_t nbtxperwrk, size_t nbaccounts, size_t expnbaccounts, Balance init_balance, float prob_long, float prob_alloc): Workload{library, AccountSegment::align(), AccountSegment::size(nbaccounts)}, nbworkers{nbworkers}, nbtxperwrk{nbtxperwrk}, nbaccounts{nbaccounts}, expnbaccounts{expnbaccounts}, init_balance{init_balance}, prob_long{prob_long}, prob_alloc{prob_alloc}, barrier{nbworkers} {}
+    WorkloadBank(TransactionalLibrary const& library, size_t nbworkers, size_t nbtxperwrk, size_t nbaccounts, size_t expnbaccounts, Balance init_balance, float prob_long, float prob_alloc, bool commutative = false): Workload{library, AccountSegment::align(), AccountSegment::size(nbaccounts)}, nbworkers{nbworkers}, nbtxperwrk{nbtxperwrk}, nbaccounts{nbaccounts}, expnbaccounts{expnbaccounts}, init_balance{init_balance}, prob_long{prob_long}, prob_alloc{prob_alloc}, commutative{commutative}, barrier{nbworkers}, workers(nbworkers) {}
 private:
     /** Long read-only transaction, summing the balance of each account.
-     * @param count Loosely-updated number of accounts
+     * @param count    Loosely-updated number of accounts
+     * @param attempts Accounting of the attempts
      * @return Whether no inconsistency has been found
     **/
-    bool long_tx(size_t& nbaccounts) const {
-        return transactional(tm, Transaction::Mode::read_only, [&](Transaction& tx) {
+    bool long_tx(size_t& nbaccounts, Attempts& attempts) const {
+        return transactional(tm, Transaction::Mode::read_only, attempts, [&](Transaction& tx) {
             auto count = 0ul; // Total number of accounts seen.
             auto sum   = Balance{0}; // Total balance on all seen accounts + parity ammount.
             auto start = tm.get_start(); // The list of accounts starts at the first word of the shared memory region.
@@ -181,10 +211,11 @@ private:
         });
     }
     /** Account (de)allocation transaction, adding accounts with initial balance or removing them.
-     * @param trigger Trigger level that will decide whether to allocate or deallocate
+     * @param trigger  Trigger level that will decide whether to allocate or deallocate
+     * @param attempts Accounting of the attempts
     **/
-    void alloc_tx(size_t trigger) const {
-        return transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) {
+    void alloc_tx(size_t trigger, Attempts& attempts) const {
+        return transactional(tm, Transaction::Mode::read_write, attempts, [&](Transaction& tx) {
             auto count = 0ul; // Total number of accounts seen.
             void* prev = nullptr;
             auto start = tm.get_start();
@@ -225,12 +256,13 @@ private:
         });
     }
     /** Short read-write transaction, transferring one unit from an account to an account (potentially the same).
-     * @param send_id Index of the sender account
-     * @param recv_id Index of the receiver account (potentially same as source)
+     * @param send_id  Index of the sender account
+     * @param recv_id  Index of the receiver account (potentially same as source)
+     * @param attempts Accounting of the attempts
      * @return Whether the parameters were satisfying and the transaction committed on useful work
     **/
-    bool short_tx(size_t send_id, size_t recv_id) const {
-        return transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) {
+    bool short_tx(size_t send_id, size_t recv_id, Attempts& attempts) const {
+        return transactional(tm, Transaction::Mode::read_write, attempts, [&](Transaction& tx) {
             void* send_ptr = nullptr;
             void* recv_ptr = nullptr;
 
@@ -268,7 +300,11 @@ private:
             auto send_val = sender.read();
             if (send_val > 0) {
                 sender = send_val - 1;
-                recver = recver.read() + 1;
+                if (commutative) {
+                    recver += 1; // Commutes with the other transfers to the same account
+                } else {
+                    recver = recver.read() + 1;
+                }
             }
             return true;
         });
@@ -297,30 +333,88 @@ public:
      * Run nbtxperwrk random transactions until completion.
      * @param seed Randomness source
     **/
-    virtual char const* run(Uid uid [[gnu::unused]], Seed seed) const {
+    virtual char const* run(Uid uid, Seed seed) const {
         ::std::minstd_rand engine{seed};
         ::std::bernoulli_distribution long_dist{prob_long};
         ::std::bernoulli_distribution alloc_dist{prob_alloc};
         ::std::gamma_distribution<float> alloc_trigger(expnbaccounts, 1);
+        auto& worker = workers[uid];
+        auto record = [&](TxType type, Chrono& chrono) { worker.latencies[static_cast<size_t>(type)].record(chrono.delta()); };
+        auto attempts = [&](TxType type) -> Attempts& { return worker.attempts[static_cast<size_t>(type)]; };
+        Chrono chrono;
         size_t count = nbaccounts;
         for (size_t cntr = 0; cntr < nbtxperwrk; ++cntr) {
             if (long_dist(engine)) { // We roll a dice and, if "lucky", run a long transaction.
-                if (unlikely(!long_tx(count))) // If it fails, then we return an error message.
+                chrono.start();
+                auto correct = long_tx(count, attempts(TxType::long_tx));
+                record(TxType::long_tx, chrono);
+                if (unlikely(!correct)) // If it fails, then we return an error message.
                     return "Violated isolation or atomicity";
             } else if (alloc_dist(engine)) { // Let's roll a dice again to trigger an allocation transaction.
-                alloc_tx(alloc_trigger(engine));
+                chrono.start();
+                alloc_tx(alloc_trigger(engine), attempts(TxType::alloc_tx));
+                record(TxType::alloc_tx, chrono);
             } else { // No luck with previous rolls, let's just run a short transaction.
                 ::std::uniform_int_distribution<size_t> account{0, count - 1};
-                while (unlikely(!short_tx(account(engine), account(engine))));
+                while (true) {
+                    chrono.start();
+                    auto done = short_tx(account(engine), account(engine), attempts(TxType::short_tx));
+                    record(TxType::short_tx, chrono);
+                    if (likely(done))
+                        break;
+                }
             }
         }
         { // Last long transaction
             size_t dummy;
-            if (!long_tx(dummy))
+            chrono.start();
+            auto correct = long_tx(dummy, attempts(TxType::long_tx));
+            record(TxType::long_tx, chrono);
+            if (!correct)
                 return "Violated isolation or atomicity";
         }
         return nullptr;
     }
+    /** Forget the latencies and attempts of the transactions run so far (not thread-safe with 'run').
+    **/
+    virtual void reset() const {
+        for (auto&& worker: workers)
+            worker = WorkerStats{};
+    }
+    /** Latency histograms of the transactions run so far, merged over the workers (not thread-safe with 'run').
+     * @return Merged histograms
+    **/
+    Latencies get_latencies() const {
+        Latencies merged;
+        for (auto&& worker: workers)
+            for (size_t i = 0; i < nbtxtypes; ++i)
+                merged[i].merge(worker.latencies[i]);
+        return merged;
+    }
+    /** Latency histograms of the transactions run so far by a worker (not thread-safe with 'run').
+     * @param uid Worker unique ID
+     * @return Histograms of the worker
+    **/
+    Latencies const& get_latencies(Uid uid) const {
+        return workers[uid].latencies;
+    }
+    /** Attempts of the transactions run so far by a worker (not thread-safe with 'run').
+     * @param uid Worker unique ID
+     * @return Attempts of the worker
+    **/
+    TxAttempts const& get_attempts(Uid uid) const {
+        return workers[uid].attempts;
+    }
+    /** Attempts of the transactions run so far, merged over the workers (not thread-safe with 'run').
+     * @return Merged attempts
+    **/
+    TxAttempts get_attempts() const {
+        TxAttempts merged;
+        for (auto&& worker: workers)
+            for (size_t i = 0; i < nbtxtypes; ++i)
+                merged[i].merge(worker.attempts[i]);
+        return merged;
+    }
     /**
      * Test in which we check that multiple concurrent transactions can decrease a counter in a sequential manner.
      * @param uid Id of the thread to run the check
@@ -61,3 +61,97 @@ extern "C" {
     Alloc    tm_alloc(shared_t, tx_t, size_t, void**) noexcept;
     bool     tm_free(shared_t, tx_t, void*) noexcept;
 }
+
+// -------------------------------------------------------------------------- //
+
+// Optional entry points: a library may leave them out, the grading program
+// then falls back to the mandatory ones.
+
+extern "C" {
+    // Add a (two's complement) delta to the width-byte integer at the start of
+    // a shared word, commutatively: concurrent additions do not conflict. The
+    // transaction must not read or write that word after adding to it.
+    bool     tm_add(shared_t, tx_t, void*, int64_t, size_t) noexcept;
+
+    // Contention management hook, for the caller of a transaction that just
+    // aborted: time to wait (in nanoseconds) before retrying it, 0 for at once.
+    uint64_t tm_should_wait(shared_t) noexcept;
+
+    // Begin a read-write transaction that does not abort: it waits for
+    // exclusive access to the region, holding back the transactions that begin
+    // after it.
+    tx_t     tm_begin_irrevocable(shared_t) noexcept;
+}
+
+// Why a transaction aborted, index in tm_stats::aborts
+enum tm_abort_reason: int {
+    tm_abort_read_written,  // Read a word written by another transaction
+    tm_abort_write_read,    // Wrote a word read by other transactions
+    tm_abort_write_written, // Wrote a word written by another transaction
+    tm_abort_add,           // Added to a word read or written by others, or
+                            // read or wrote a word others added to
+    tm_abort_validation,    // A word read changed before commit
+    tm_abort_nomem,         // Out of memory for the logs of the transaction
+    tm_abort_reasons
+};
+
+// Word of the shared region that made transactions abort
+struct tm_abort_site {
+    size_t   segment; // Index of the segment, 0 for the first one
+    size_t   word;    // Index of the word in the segment (offset / alignment)
+    uint64_t count;   // Aborts, at least (tracked per thread, top ones only)
+};
+
+// How a transaction was synchronized, index in tm_stats::begins and commits
+enum tm_stats_mode: int {
+    tm_mode_batcher,    // Epochs of a batcher
+    tm_mode_lock,       // One lock for the whole region
+    tm_mode_optimistic, // Optimistic, validated at commit
+    tm_modes
+};
+
+constexpr static size_t tm_stats_sites = 16;
+
+struct tm_stats {
+    size_t   threads;                 // Threads that ran transactions
+    uint64_t begins[tm_modes];
+    uint64_t commits[tm_modes];
+    uint64_t aborts[tm_abort_reasons];
+    uint64_t reads;                   // Words read
+    uint64_t writes;                  // Words written
+    uint64_t adds;                    // Additions (tm_add)
+    uint64_t epochs;                  // Epochs ended
+    uint64_t commit_ns;               // Time spent committing (tm_end), from
+                                      // a sample of the commits
+    uint64_t wait_ns;                 // Time spent waiting for an epoch
+    uint64_t irrevocable;             // Transactions begun irrevocably
+    uint64_t promoted;                // Of which after too many aborts
+    tm_abort_site sites[tm_stats_sites]; // Most aborts first, then zeroed
+                                         // entries
+};
+
+extern "C" {
+    // Counters of the region, summed over its threads (tm_stats), or of the
+    // calling thread only (tm_stats_thread). False if none are kept, i.e. the
+    // library was built without them.
+    bool     tm_stats(shared_t, struct tm_stats*) noexcept;
+    bool     tm_stats_thread(shared_t, struct tm_stats*) noexcept;
+}
+
+// Word of the shared region contended by transactions
+struct tm_hot_word {
+    size_t   segment;      // Index of the segment, 0 for the first one
+    size_t   offset;       // Offset (in bytes) in the segment, i.e. from
+                           // tm_start for the first one
+    uint64_t contention;   // Conflicts and failed compare-and-swaps on it,
+                           // estimated (at most over-estimated)
+    uint64_t conflicts;    // Conflicts, counted since it is among the top
+    uint64_t cas_failures; // Failed compare-and-swaps, same
+};
+
+extern "C" {
+    // Most contended words of the region, most first, into the given array of
+    // the given size. Returns how many were filled, 0 if the region is not
+    // profiled (TM_PROFILE unset, or the library was built without it).
+    size_t   tm_profile(shared_t, struct tm_hot_word*, size_t) noexcept;
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+// Compile-time options of the transaction manager. Each option can be
+// overridden from the command line, e.g. make CC="cc -DCACHE_LINE_SIZE=128".
+
+// Size of a cache line. The global sequence lock is kept alone on its line.
+#ifndef CACHE_LINE_SIZE
+#define CACHE_LINE_SIZE 64
+#endif
+
+#define cache_aligned _Alignas(CACHE_LINE_SIZE)
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "config.h"
+#include "macros.h"
+
+// Header of a segment, the segment follows it at seg_header_size(reg) bytes
+struct Segment {
+  struct Segment *next;      // Next segment ever allocated
+  struct Segment *next_free; // Next segment in the pool of freed segments
+  size_t size;               // Size of the segment (in bytes)
+};
+
+struct Region {
+  // Global sequence lock: odd while a writer writes back, incremented by 2 by
+  // every committing writer. The only metadata of the shared words.
+  cache_aligned atomic_uint_fast64_t seq;
+
+  // Read-mostly
+  cache_aligned void *start; // First, non-freeable segment
+  size_t size;               // Size of the first segment (in bytes)
+  size_t align;              // Alignment of the words (in bytes)
+  unsigned int align_shift;  // log2 of the alignment
+
+  // Allocations and frees
+  cache_aligned pthread_mutex_t segments_lock;
+  struct Segment *segments; // Every segment ever allocated, but the first
+  struct Segment *pool;     // Freed segments, to reuse
+};
+
+// Freed segments are never given back to the system before tm_destroy, but
+// are reused: a transaction still reading a freed segment only ever sees mapped
+// memory, and the free bumped the sequence lock, so it validates and aborts.
+void *seg_alloc(struct Region *reg, size_t size);
+void seg_release(struct Region *reg, void *segment);
+void seg_destroy_all(struct Region *reg);
+size_t seg_size(struct Region *reg, void const *segment);
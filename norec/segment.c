@@ -0,0 +1,75 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "region.h"
+
+// The header is padded to the alignment, so that the segment stays aligned
+static size_t seg_header_size(struct Region *reg) {
+  return (sizeof(struct Segment) + reg->align - 1) & ~(reg->align - 1);
+}
+
+static struct Segment *seg_header(struct Region *reg, void const *segment) {
+  return (struct Segment *)((char *)segment - seg_header_size(reg));
+}
+
+void *seg_alloc(struct Region *reg, size_t size) {
+  struct Segment *seg = NULL;
+
+  // Reuse a freed segment of the same size, if any
+  pthread_mutex_lock(&reg->segments_lock);
+  for (struct Segment **prev = &reg->pool; *prev != NULL;
+       prev = &(*prev)->next_free) {
+    if ((*prev)->size == size) {
+      seg = *prev;
+      *prev = seg->next_free;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&reg->segments_lock);
+
+  if (seg == NULL) {
+    size_t align = reg->align < sizeof(void *) ? sizeof(void *) : reg->align;
+
+    if (unlikely(posix_memalign((void **)&seg, align,
+                                seg_header_size(reg) + size) != 0)) {
+      return NULL;
+    }
+
+    seg->size = size;
+
+    pthread_mutex_lock(&reg->segments_lock);
+    seg->next = reg->segments;
+    reg->segments = seg;
+    pthread_mutex_unlock(&reg->segments_lock);
+  }
+
+  void *segment = (char *)seg + seg_header_size(reg);
+
+  memset(segment, 0, size);
+
+  return segment;
+}
+
+void seg_release(struct Region *reg, void *segment) {
+  struct Segment *seg = seg_header(reg, segment);
+
+  pthread_mutex_lock(&reg->segments_lock);
+  seg->next_free = reg->pool;
+  reg->pool = seg;
+  pthread_mutex_unlock(&reg->segments_lock);
+}
+
+void seg_destroy_all(struct Region *reg) {
+  while (reg->segments != NULL) {
+    struct Segment *next = reg->segments->next;
+
+    free(reg->segments);
+    reg->segments = next;
+  }
+}
+
+size_t seg_size(struct Region *reg, void const *segment) {
+  return seg_header(reg, segment)->size;
+}
@@ -0,0 +1,319 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "tx.h"
+
+#define INDEX_INIT_BITS 8
+
+// Transaction of the calling thread, reused from one transaction to the next
+// so that its logs keep their capacity. Freed when the thread exits.
+static _Thread_local struct Transaction *cached_tx = NULL;
+static pthread_key_t cached_tx_key;
+static pthread_once_t cached_tx_once = PTHREAD_ONCE_INIT;
+
+static struct Transaction *tx_create(void) {
+  struct Transaction *tx =
+      (struct Transaction *)calloc(1, sizeof(struct Transaction));
+
+  if (unlikely(tx == NULL)) {
+    return NULL;
+  }
+
+  init_list(&tx->reads, sizeof(void const *));
+  init_list(&tx->writes, sizeof(void *));
+  init_list(&tx->alloced, sizeof(void *));
+  init_list(&tx->freed, sizeof(void *));
+
+  return tx;
+}
+
+static void tx_destroy(void *arg) {
+  struct Transaction *tx = (struct Transaction *)arg;
+
+  destroy_list(&tx->reads);
+  destroy_list(&tx->writes);
+  destroy_list(&tx->alloced);
+  destroy_list(&tx->freed);
+  free(tx->values);
+  free(tx->data);
+  free(tx->index);
+  free(tx);
+}
+
+static void cached_tx_init(void) {
+  pthread_key_create(&cached_tx_key, tx_destroy);
+}
+
+// Wait for the sequence lock to be free, and return it
+static uint_fast64_t snapshot(struct Region *reg) {
+  uint_fast64_t seq = atomic_load(&reg->seq);
+
+  while (seq & 1) {
+    sched_yield();
+    seq = atomic_load(&reg->seq);
+  }
+
+  return seq;
+}
+
+struct Transaction *tx_begin(struct Region *reg, bool is_ro) {
+  struct Transaction *tx = cached_tx;
+
+  // A thread running transactions on several regions at once gets a fresh
+  // transaction for all but the first one
+  if (unlikely(tx == NULL || tx->in_use)) {
+    tx = tx_create();
+
+    if (unlikely(tx == NULL)) {
+      return NULL;
+    }
+
+    if (cached_tx == NULL) {
+      pthread_once(&cached_tx_once, cached_tx_init);
+      pthread_setspecific(cached_tx_key, tx);
+      cached_tx = tx;
+    }
+  }
+
+  tx->reg = reg;
+  tx->is_ro = is_ro;
+  tx->in_use = tx == cached_tx;
+  tx->snapshot = snapshot(reg);
+
+  return tx;
+}
+
+void tx_end(struct Transaction *tx) {
+  if (tx->writes.n > 0) {
+    memset(tx->index, 0, sizeof(uint32_t) << tx->index_bits);
+  }
+
+  tx->reads.n = 0;
+  tx->writes.n = 0;
+  tx->alloced.n = 0;
+  tx->freed.n = 0;
+
+  if (tx == cached_tx) {
+    tx->in_use = false;
+  } else {
+    tx_destroy(tx);
+  }
+}
+
+static inline size_t write_hash(struct Transaction *tx, void const *target) {
+  return (((uintptr_t)target >> tx->reg->align_shift) *
+          UINT64_C(0x9E3779B97F4A7C15)) >>
+         (64 - tx->index_bits);
+}
+
+// Index of the redo log entry of the given word, -1 if not written
+static ssize_t write_find(struct Transaction *tx, void const *target) {
+  size_t mask = ((size_t)1 << tx->index_bits) - 1;
+
+  for (size_t slot = write_hash(tx, target);; slot = (slot + 1) & mask) {
+    uint32_t entry = tx->index[slot];
+
+    if (entry == 0) {
+      return -1;
+    }
+    if (get_list(&tx->writes, entry - 1, void *) == target) {
+      return entry - 1;
+    }
+  }
+}
+
+static void write_index(struct Transaction *tx, size_t i) {
+  size_t mask = ((size_t)1 << tx->index_bits) - 1;
+  size_t slot = write_hash(tx, get_list(&tx->writes, i, void *));
+
+  while (tx->index[slot] != 0) {
+    slot = (slot + 1) & mask;
+  }
+
+  tx->index[slot] = i + 1;
+}
+
+// Make room for one more word in the given log values
+static bool values_grow(char **values, size_t *size, size_t n, size_t align) {
+  if ((n + 1) * align > *size) {
+    size_t new_size = *size == 0 ? 64 * align : 2 * *size;
+    char *new_values = realloc(*values, new_size);
+
+    if (unlikely(new_values == NULL)) {
+      return false;
+    }
+
+    *values = new_values;
+    *size = new_size;
+  }
+
+  return true;
+}
+
+// Keep the index at most half full
+static bool write_grow(struct Transaction *tx) {
+  if (unlikely(!values_grow(&tx->data, &tx->data_size, tx->writes.n,
+                            tx->reg->align))) {
+    return false;
+  }
+
+  if (tx->index == NULL ||
+      2 * (tx->writes.n + 1) > ((size_t)1 << tx->index_bits)) {
+    unsigned int bits =
+        tx->index == NULL ? INDEX_INIT_BITS : tx->index_bits + 1;
+    uint32_t *index = calloc((size_t)1 << bits, sizeof(uint32_t));
+
+    if (unlikely(index == NULL)) {
+      return false;
+    }
+
+    free(tx->index);
+    tx->index = index;
+    tx->index_bits = bits;
+
+    for (size_t i = 0; i < tx->writes.n; ++i) {
+      write_index(tx, i);
+    }
+  }
+
+  return true;
+}
+
+// Check that every word read still has the value it was read with, at a time
+// no writer is writing back, which becomes the new snapshot
+static bool validate(struct Transaction *tx) {
+  struct Region *reg = tx->reg;
+
+  for (;;) {
+    uint_fast64_t seq = snapshot(reg);
+
+    for (size_t i = 0; i < tx->reads.n; ++i) {
+      if (memcmp(get_list(&tx->reads, i, void const *),
+                 tx->values + i * reg->align, reg->align) != 0) {
+        return false;
+      }
+    }
+
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&reg->seq, memory_order_relaxed) == seq) {
+      tx->snapshot = seq;
+      return true;
+    }
+  }
+}
+
+// Copy one word, most words being 8 bytes
+static inline void word_copy(void *target, void const *source, size_t align) {
+  if (likely(align == sizeof(uint64_t))) {
+    memcpy(target, source, sizeof(uint64_t));
+  } else {
+    memcpy(target, source, align);
+  }
+}
+
+bool tx_read(struct Transaction *tx, void const *source, void *target) {
+  struct Region *reg = tx->reg;
+  size_t align = reg->align;
+
+  if (tx->writes.n > 0) {
+    ssize_t i = write_find(tx, source);
+
+    if (i >= 0) {
+      memcpy(target, tx->data + i * align, align);
+      return true;
+    }
+  }
+
+  if (unlikely((tx->reads.n + 1) * align > tx->values_size) &&
+      unlikely(!values_grow(&tx->values, &tx->values_size, tx->reads.n,
+                            align))) {
+    return false;
+  }
+
+  word_copy(target, source, align);
+
+  // A writer committed since the snapshot: the read is only consistent with
+  // the previous ones if these still hold
+  atomic_thread_fence(memory_order_acquire);
+  while (atomic_load_explicit(&reg->seq, memory_order_relaxed) !=
+         tx->snapshot) {
+    if (!validate(tx)) {
+      return false;
+    }
+
+    word_copy(target, source, align);
+    atomic_thread_fence(memory_order_acquire);
+  }
+
+  word_copy(tx->values + tx->reads.n * align, target, align);
+  insert_list(&tx->reads, source, void const *);
+
+  return true;
+}
+
+bool tx_write(struct Transaction *tx, void const *source, void *target) {
+  size_t align = tx->reg->align;
+  ssize_t i = tx->writes.n > 0 ? write_find(tx, target) : -1;
+
+  if (i < 0) {
+    if (unlikely((tx->writes.n + 1) * align > tx->data_size ||
+                 2 * (tx->writes.n + 1) > ((size_t)1 << tx->index_bits)) &&
+        unlikely(!write_grow(tx))) {
+      return false;
+    }
+
+    i = tx->writes.n;
+    insert_list(&tx->writes, target, void *);
+    write_index(tx, i);
+  }
+
+  word_copy(tx->data + i * align, source, align);
+
+  return true;
+}
+
+bool tx_commit(struct Transaction *tx) {
+  struct Region *reg = tx->reg;
+
+  // Reads were consistent at the snapshot, nothing to publish
+  if (tx->writes.n == 0 && tx->freed.n == 0) {
+    return true;
+  }
+
+  // Take the sequence lock, as long as no other writer committed since the
+  // (revalidated) snapshot
+  uint_fast64_t seq = tx->snapshot;
+
+  while (!atomic_compare_exchange_strong(&reg->seq, &seq, tx->snapshot + 1)) {
+    if (!validate(tx)) {
+      return false;
+    }
+
+    seq = tx->snapshot;
+  }
+
+  for (size_t i = 0; i < tx->writes.n; ++i) {
+    memcpy(get_list(&tx->writes, i, void *), tx->data + i * reg->align,
+           reg->align);
+  }
+
+  atomic_store_explicit(&reg->seq, tx->snapshot + 2, memory_order_release);
+
+  for (size_t i = 0; i < tx->freed.n; ++i) {
+    seg_release(reg, get_list(&tx->freed, i, void *));
+  }
+
+  return true;
+}
+
+// The allocated segments were never published, give them back at once
+void tx_abort(struct Transaction *tx) {
+  for (size_t i = 0; i < tx->alloced.n; ++i) {
+    seg_release(tx->reg, get_list(&tx->alloced, i, void *));
+  }
+}
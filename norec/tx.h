@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "region.h"
+#include "simple_list.h"
+
+struct Transaction {
+  struct Region *reg;
+  uint_fast64_t snapshot; // Even value of the sequence lock the reads match
+  bool is_ro;             // Is read only
+  bool in_use;            // Is the cached transaction of its thread, and running
+
+  // Read log: the i-th read word (void const *) had value values + i * align
+  struct List reads;
+  char *values;
+  size_t values_size; // Capacity of values (in bytes)
+
+  // Redo log: the i-th written word (void *) has its value at data + i * align
+  struct List writes;
+  char *data;
+  size_t data_size;        // Capacity of data (in bytes)
+  uint32_t *index;         // Open-addressing index of writes, holding (i + 1)
+  unsigned int index_bits; // log2 of the number of index entries
+
+  struct List alloced; // Segments allocated (void *)
+  struct List freed;   // Segments to free at commit (void *)
+};
+
+struct Transaction *tx_begin(struct Region *reg, bool is_ro);
+void tx_end(struct Transaction *tx);
+
+bool tx_read(struct Transaction *tx, void const *source, void *target);
+bool tx_write(struct Transaction *tx, void const *source, void *target);
+bool tx_commit(struct Transaction *tx);
+void tx_abort(struct Transaction *tx);
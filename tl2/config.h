@@ -0,0 +1,17 @@
+#pragma once
+
+// Compile-time options of the transaction manager. Each option can be
+// overridden from the command line, e.g. make CC="cc -DLOCK_SHIFT=22".
+
+// log2 of the number of versioned write locks. Words are mapped to the locks
+// by address, distinct words may share a lock.
+#ifndef LOCK_SHIFT
+#define LOCK_SHIFT 20
+#endif
+
+// Size of a cache line. The global version clock is kept alone on its line.
+#ifndef CACHE_LINE_SIZE
+#define CACHE_LINE_SIZE 64
+#endif
+
+#define cache_aligned _Alignas(CACHE_LINE_SIZE)
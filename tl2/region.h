@@ -0,0 +1,55 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "config.h"
+#include "macros.h"
+
+// Versioned write lock. Unlocked, it holds (version << 1). Locked, it holds the
+// address of the owner's struct Lock entry | 1, which keeps the version the
+// lock had before being taken.
+typedef atomic_uintptr_t vlock_t;
+
+#define VLOCK_LOCKED(x) ((x)&1)
+#define VLOCK_VERSION(x) ((x) >> 1)
+#define VLOCK_UNLOCKED(version) ((uintptr_t)(version) << 1)
+
+// Header of a segment, the segment follows it at seg_header_size(reg) bytes
+struct Segment {
+  struct Segment *next;      // Next segment ever allocated
+  struct Segment *next_free; // Next segment in the pool of freed segments
+  size_t size;               // Size of the segment (in bytes)
+};
+
+struct Region {
+  // Global version clock, incremented by every committing writer
+  cache_aligned atomic_uint_fast64_t clock;
+
+  // Read-mostly
+  cache_aligned void *start; // First, non-freeable segment
+  size_t size;               // Size of the first segment (in bytes)
+  size_t align;              // Alignment of the words (in bytes)
+  unsigned int align_shift;  // log2 of the alignment
+  vlock_t *locks;            // (1 << LOCK_SHIFT) versioned write locks
+
+  // Allocations and frees
+  cache_aligned pthread_mutex_t segments_lock;
+  struct Segment *segments; // Every segment ever allocated, but the first
+  struct Segment *pool;     // Freed segments, to reuse
+};
+
+static inline vlock_t *word_lock(struct Region *reg, void const *address) {
+  return &reg->locks[((uintptr_t)address >> reg->align_shift) &
+                     (((uintptr_t)1 << LOCK_SHIFT) - 1)];
+}
+
+// Freed segments are never given back to the system before tm_destroy, but
+// are reused: a transaction still reading a freed segment only ever sees mapped
+// memory, whose lock versions were bumped by the free and make it abort.
+void *seg_alloc(struct Region *reg, size_t size);
+void seg_release(struct Region *reg, void *segment);
+void seg_destroy_all(struct Region *reg);
+size_t seg_size(struct Region *reg, void const *segment);
@@ -0,0 +1,363 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "tx.h"
+
+#define INDEX_INIT_BITS 8
+
+// Transaction of the calling thread, reused from one transaction to the next
+// so that its logs keep their capacity. Freed when the thread exits.
+static _Thread_local struct Transaction *cached_tx = NULL;
+static pthread_key_t cached_tx_key;
+static pthread_once_t cached_tx_once = PTHREAD_ONCE_INIT;
+
+static struct Transaction *tx_create(void) {
+  struct Transaction *tx =
+      (struct Transaction *)calloc(1, sizeof(struct Transaction));
+
+  if (unlikely(tx == NULL)) {
+    return NULL;
+  }
+
+  init_list(&tx->reads, sizeof(vlock_t *));
+  init_list(&tx->writes, sizeof(void *));
+  init_list(&tx->locks, sizeof(struct Lock));
+  init_list(&tx->alloced, sizeof(void *));
+  init_list(&tx->freed, sizeof(void *));
+
+  return tx;
+}
+
+static void tx_destroy(void *arg) {
+  struct Transaction *tx = (struct Transaction *)arg;
+
+  destroy_list(&tx->reads);
+  destroy_list(&tx->writes);
+  destroy_list(&tx->locks);
+  destroy_list(&tx->alloced);
+  destroy_list(&tx->freed);
+  free(tx->data);
+  free(tx->index);
+  free(tx);
+}
+
+static void cached_tx_init(void) {
+  pthread_key_create(&cached_tx_key, tx_destroy);
+}
+
+struct Transaction *tx_begin(struct Region *reg, bool is_ro) {
+  struct Transaction *tx = cached_tx;
+
+  // A thread running transactions on several regions at once gets a fresh
+  // transaction for all but the first one
+  if (unlikely(tx == NULL || tx->in_use)) {
+    tx = tx_create();
+
+    if (unlikely(tx == NULL)) {
+      return NULL;
+    }
+
+    if (cached_tx == NULL) {
+      pthread_once(&cached_tx_once, cached_tx_init);
+      pthread_setspecific(cached_tx_key, tx);
+      cached_tx = tx;
+    }
+  }
+
+  tx->reg = reg;
+  tx->is_ro = is_ro;
+  tx->in_use = tx == cached_tx;
+  tx->rv = atomic_load(&reg->clock);
+
+  return tx;
+}
+
+void tx_end(struct Transaction *tx) {
+  if (tx->writes.n > 0) {
+    memset(tx->index, 0, sizeof(uint32_t) << tx->index_bits);
+  }
+
+  tx->reads.n = 0;
+  tx->writes.n = 0;
+  tx->locks.n = 0;
+  tx->alloced.n = 0;
+  tx->freed.n = 0;
+
+  if (tx == cached_tx) {
+    tx->in_use = false;
+  } else {
+    tx_destroy(tx);
+  }
+}
+
+static inline size_t write_hash(struct Transaction *tx, void const *target) {
+  return (((uintptr_t)target >> tx->reg->align_shift) *
+          UINT64_C(0x9E3779B97F4A7C15)) >>
+         (64 - tx->index_bits);
+}
+
+// Index of the redo log entry of the given word, -1 if not written
+static ssize_t write_find(struct Transaction *tx, void const *target) {
+  size_t mask = ((size_t)1 << tx->index_bits) - 1;
+
+  for (size_t slot = write_hash(tx, target);; slot = (slot + 1) & mask) {
+    uint32_t entry = tx->index[slot];
+
+    if (entry == 0) {
+      return -1;
+    }
+    if (get_list(&tx->writes, entry - 1, void *) == target) {
+      return entry - 1;
+    }
+  }
+}
+
+static void write_index(struct Transaction *tx, size_t i) {
+  size_t mask = ((size_t)1 << tx->index_bits) - 1;
+  size_t slot = write_hash(tx, get_list(&tx->writes, i, void *));
+
+  while (tx->index[slot] != 0) {
+    slot = (slot + 1) & mask;
+  }
+
+  tx->index[slot] = i + 1;
+}
+
+// Keep the index at most half full
+static bool write_grow(struct Transaction *tx) {
+  size_t align = tx->reg->align;
+  size_t needed = (tx->writes.n + 1) * align;
+
+  if (needed > tx->data_size) {
+    size_t size = tx->data_size == 0 ? 64 * align : 2 * tx->data_size;
+    char *data = realloc(tx->data, size);
+
+    if (unlikely(data == NULL)) {
+      return false;
+    }
+
+    tx->data = data;
+    tx->data_size = size;
+  }
+
+  if (tx->index == NULL ||
+      2 * (tx->writes.n + 1) > ((size_t)1 << tx->index_bits)) {
+    unsigned int bits =
+        tx->index == NULL ? INDEX_INIT_BITS : tx->index_bits + 1;
+    uint32_t *index = calloc((size_t)1 << bits, sizeof(uint32_t));
+
+    if (unlikely(index == NULL)) {
+      return false;
+    }
+
+    free(tx->index);
+    tx->index = index;
+    tx->index_bits = bits;
+
+    for (size_t i = 0; i < tx->writes.n; ++i) {
+      write_index(tx, i);
+    }
+  }
+
+  return true;
+}
+
+bool tx_read(struct Transaction *tx, void const *source, void *target) {
+  size_t align = tx->reg->align;
+
+  if (tx->writes.n > 0) {
+    ssize_t i = write_find(tx, source);
+
+    if (i >= 0) {
+      memcpy(target, tx->data + i * align, align);
+      return true;
+    }
+  }
+
+  vlock_t *lock = word_lock(tx->reg, source);
+  uintptr_t pre = atomic_load_explicit(lock, memory_order_acquire);
+
+  if (VLOCK_LOCKED(pre) || VLOCK_VERSION(pre) > tx->rv) {
+    return false;
+  }
+
+  memcpy(target, source, align);
+
+  // The word did not change while being copied
+  atomic_thread_fence(memory_order_acquire);
+  if (atomic_load_explicit(lock, memory_order_relaxed) != pre) {
+    return false;
+  }
+
+  if (!tx->is_ro) {
+    insert_list(&tx->reads, lock, vlock_t *);
+  }
+
+  return true;
+}
+
+bool tx_write(struct Transaction *tx, void const *source, void *target) {
+  size_t align = tx->reg->align;
+  ssize_t i = tx->writes.n > 0 ? write_find(tx, target) : -1;
+
+  if (i < 0) {
+    if (unlikely(!write_grow(tx))) {
+      return false;
+    }
+
+    i = tx->writes.n;
+    insert_list(&tx->writes, target, void *);
+    write_index(tx, i);
+  }
+
+  memcpy(tx->data + i * align, source, align);
+
+  return true;
+}
+
+static inline bool lock_owned(struct Transaction *tx, uintptr_t value) {
+  struct Lock *lock = (struct Lock *)(value & ~(uintptr_t)1);
+
+  return lock >= &get_list(&tx->locks, 0, struct Lock) &&
+         lock < &get_list(&tx->locks, tx->locks.n, struct Lock);
+}
+
+// Take the given lock, unless already taken by this transaction. The locks
+// list must have room for it, so that the entries do not move.
+static bool lock_take(struct Transaction *tx, vlock_t *lock) {
+  uintptr_t value = atomic_load_explicit(lock, memory_order_relaxed);
+
+  if (VLOCK_LOCKED(value)) {
+    return lock_owned(tx, value);
+  }
+
+  struct Lock *entry = &get_list(&tx->locks, tx->locks.n, struct Lock);
+
+  entry->lock = lock;
+  entry->version = VLOCK_VERSION(value);
+
+  if (!atomic_compare_exchange_strong(lock, &value, (uintptr_t)entry | 1)) {
+    return false;
+  }
+
+  ++tx->locks.n;
+
+  return true;
+}
+
+// Number of locks covering the given segment
+static size_t segment_locks(struct Region *reg, void const *segment) {
+  size_t words = seg_size(reg, segment) >> reg->align_shift;
+
+  return words < ((size_t)1 << LOCK_SHIFT) ? words : (size_t)1 << LOCK_SHIFT;
+}
+
+// Freeing a segment writes all of its words, so transactions still reading it
+// abort
+static bool lock_segment(struct Transaction *tx, void const *segment) {
+  struct Region *reg = tx->reg;
+  size_t n = segment_locks(reg, segment);
+
+  for (size_t i = 0; i < n; ++i) {
+    if (!lock_take(tx, word_lock(reg, (char const *)segment +
+                                          (i << reg->align_shift)))) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static bool validate(struct Transaction *tx) {
+  for (size_t i = 0; i < tx->reads.n; ++i) {
+    uintptr_t value = atomic_load(get_list(&tx->reads, i, vlock_t *));
+    uintptr_t version;
+
+    if (VLOCK_LOCKED(value)) {
+      if (!lock_owned(tx, value)) {
+        return false;
+      }
+      version = ((struct Lock *)(value & ~(uintptr_t)1))->version;
+    } else {
+      version = VLOCK_VERSION(value);
+    }
+
+    if (version > tx->rv) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static void unlock_all(struct Transaction *tx, bool committed,
+                       uint_fast64_t wv) {
+  for (size_t i = 0; i < tx->locks.n; ++i) {
+    struct Lock *lock = &get_list(&tx->locks, i, struct Lock);
+
+    atomic_store_explicit(lock->lock,
+                          VLOCK_UNLOCKED(committed ? wv : lock->version),
+                          memory_order_release);
+  }
+}
+
+bool tx_commit(struct Transaction *tx) {
+  struct Region *reg = tx->reg;
+
+  // Reads were consistent at rv, nothing to publish
+  if (tx->writes.n == 0 && tx->freed.n == 0) {
+    return true;
+  }
+
+  size_t n_locks = tx->writes.n;
+
+  for (size_t i = 0; i < tx->freed.n; ++i) {
+    n_locks += segment_locks(reg, get_list(&tx->freed, i, void *));
+  }
+  reserve_list(&tx->locks, n_locks, sizeof(struct Lock));
+
+  for (size_t i = 0; i < tx->writes.n; ++i) {
+    if (!lock_take(tx, word_lock(reg, get_list(&tx->writes, i, void *)))) {
+      unlock_all(tx, false, 0);
+      return false;
+    }
+  }
+  for (size_t i = 0; i < tx->freed.n; ++i) {
+    if (!lock_segment(tx, get_list(&tx->freed, i, void *))) {
+      unlock_all(tx, false, 0);
+      return false;
+    }
+  }
+
+  uint_fast64_t wv = atomic_fetch_add(&reg->clock, 1) + 1;
+
+  // No other writer committed since we began
+  if (wv != tx->rv + 1 && !validate(tx)) {
+    unlock_all(tx, false, 0);
+    return false;
+  }
+
+  for (size_t i = 0; i < tx->writes.n; ++i) {
+    memcpy(get_list(&tx->writes, i, void *), tx->data + i * reg->align,
+           reg->align);
+  }
+
+  unlock_all(tx, true, wv);
+
+  for (size_t i = 0; i < tx->freed.n; ++i) {
+    seg_release(reg, get_list(&tx->freed, i, void *));
+  }
+
+  return true;
+}
+
+// The allocated segments were never published, give them back at once
+void tx_abort(struct Transaction *tx) {
+  for (size_t i = 0; i < tx->alloced.n; ++i) {
+    seg_release(tx->reg, get_list(&tx->alloced, i, void *));
+  }
+}
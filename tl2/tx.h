@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "region.h"
+#include "simple_list.h"
+
+// A write lock taken at commit
+struct Lock {
+  vlock_t *lock;
+  uintptr_t version; // Version of the lock before it was taken
+};
+
+struct Transaction {
+  struct Region *reg;
+  uint_fast64_t rv; // Read version, i.e. clock when the transaction began
+  bool is_ro;       // Is read only
+  bool in_use;      // Is the cached transaction of its thread, and running
+
+  struct List reads; // Locks of the words read (vlock_t *)
+
+  // Redo log: the i-th written word (void *) has its value at data + i * align
+  struct List writes;
+  char *data;
+  size_t data_size;   // Capacity of data (in bytes)
+  uint32_t *index;    // Open-addressing index of writes, holding (i + 1)
+  unsigned int index_bits; // log2 of the number of index entries
+
+  struct List locks;   // Locks taken at commit (struct Lock)
+  struct List alloced; // Segments allocated (void *)
+  struct List freed;   // Segments to free at commit (void *)
+};
+
+struct Transaction *tx_begin(struct Region *reg, bool is_ro);
+void tx_end(struct Transaction *tx);
+
+bool tx_read(struct Transaction *tx, void const *source, void *target);
+bool tx_write(struct Transaction *tx, void const *source, void *target);
+bool tx_commit(struct Transaction *tx);
+void tx_abort(struct Transaction *tx);